@@ -0,0 +1,165 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file analysis.hpp
+ * \brief Error analysis of a classifier from its activation probabilities.
+ */
+
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "dense_network.hpp"
+#include "parallel.hpp"
+
+/*!
+ * \brief Statistics gathered from the output probabilities of a classifier
+ */
+struct classification_report {
+    std::size_t classes = 0;
+    std::size_t max_k = 0;
+    std::size_t samples = 0;
+    std::size_t errors = 0;
+    std::size_t second_right = 0;          ///< Errors for which the second guess was right
+    std::vector<std::size_t> confusion;    ///< classes x classes, label-major
+    std::vector<std::size_t> sources;      ///< Errors per label
+    std::vector<std::size_t> top_k;        ///< top_k[k - 1]: label in the k most probable classes
+
+    classification_report() = default;
+
+    classification_report(std::size_t classes, std::size_t max_k) : classes(classes), max_k(std::min(max_k, classes)),
+            confusion(classes * classes, 0), sources(classes, 0), top_k(this->max_k, 0) {}
+
+    /*!
+     * \brief Account for one sample given its output probabilities
+     */
+    void add(const float* probabilities, std::size_t label){
+        //Rank of the label: number of classes strictly more probable
+        std::size_t rank = 0;
+        std::size_t predicted = 0;
+        std::size_t second = 0;
+
+        for(std::size_t j = 0; j < classes; ++j){
+            if(probabilities[j] > probabilities[label]){
+                ++rank;
+            }
+
+            if(probabilities[j] > probabilities[predicted]){
+                predicted = j;
+            }
+        }
+
+        for(std::size_t j = 0; j < classes; ++j){
+            if(j != predicted && (second == predicted || probabilities[j] > probabilities[second])){
+                second = j;
+            }
+        }
+
+        ++samples;
+        ++confusion[label * classes + predicted];
+
+        for(std::size_t k = rank; k < max_k; ++k){
+            ++top_k[k];
+        }
+
+        if(predicted != label){
+            ++errors;
+            ++sources[label];
+
+            if(second == label){
+                ++second_right;
+            }
+        }
+    }
+
+    /*!
+     * \brief Merge the statistics of another report into this one
+     */
+    void merge(const classification_report& rhs){
+        samples += rhs.samples;
+        errors += rhs.errors;
+        second_right += rhs.second_right;
+
+        std::transform(confusion.begin(), confusion.end(), rhs.confusion.begin(), confusion.begin(), std::plus<std::size_t>());
+        std::transform(sources.begin(), sources.end(), rhs.sources.begin(), sources.begin(), std::plus<std::size_t>());
+        std::transform(top_k.begin(), top_k.end(), rhs.top_k.begin(), top_k.begin(), std::plus<std::size_t>());
+    }
+
+    void display() const {
+        std::cout << "Error rate " << 100.0 * (static_cast<double>(errors) / samples) << std::endl;
+        std::cout << errors << " errors " << " / " << samples << std::endl;
+        std::cout << "Second guess error rate " << 100.0 * ((static_cast<double>(errors) - second_right) / samples) << std::endl;
+        std::cout << "Second guess was right " << second_right << " / " << samples << std::endl;
+
+        for(std::size_t k = 1; k <= max_k; ++k){
+            std::cout << "Top-" << k << " accuracy " << 100.0 * (static_cast<double>(top_k[k - 1]) / samples) << std::endl;
+        }
+
+        std::cout << "Errors sources: ";
+        for(std::size_t i = 0; i < classes; ++i){
+            std::cout << i << ":" << sources[i] << " ";
+        }
+        std::cout << std::endl;
+
+        std::cout << "Confusion matrix (rows: labels, columns: predictions)" << std::endl;
+        std::cout << "   ";
+        for(std::size_t i = 0; i < classes; ++i){
+            std::cout << std::setw(5) << i << " ";
+        }
+        std::cout << std::endl;
+        for(std::size_t i = 0; i < classes; ++i){
+            std::cout << i << ": ";
+            for(std::size_t j = 0; j < classes; ++j){
+                std::cout << std::setw(5) << confusion[i * classes + j] << " ";
+            }
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+    }
+};
+
+/*!
+ * \brief Analyze a dense network on a set of samples.
+ *
+ * Each sample goes through a single batched forward pass. The batches
+ * are processed in parallel with one report per thread, the reports
+ * being merged at the end.
+ */
+template<typename Images, typename Labels>
+classification_report dense_analysis(const dense_network& network, const Images& images, const Labels& labels, std::size_t max_k = 3){
+    auto threads = default_threads();
+    auto classes = network.output_size();
+
+    std::vector<classification_report> reports(threads, classification_report(classes, max_k));
+
+    parallel_for_batches(images.size(), 256, [&](std::size_t first, std::size_t last, std::size_t thread){
+        std::vector<float> input;
+        std::vector<float> output((last - first) * classes);
+        dense_workspace workspace;
+
+        gather_batch(images, first, last, network.input_size(), input);
+        dense_forward(network, input.data(), last - first, output.data(), workspace);
+
+        for(std::size_t i = first; i < last; ++i){
+            reports[thread].add(&output[(i - first) * classes], labels[i]);
+        }
+    }, threads);
+
+    for(std::size_t t = 1; t < threads; ++t){
+        reports[0].merge(reports[t]);
+    }
+
+    return reports[0];
+}
+
+#endif
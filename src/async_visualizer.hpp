@@ -0,0 +1,371 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file async_visualizer.hpp
+ * \brief Training visualizers that render the filters on their own thread.
+ *
+ * The training thread only copies the weights into a double buffer. A
+ * render thread draws the latest snapshot, older snapshots that were
+ * not rendered in time are dropped. HighGUI is not thread-safe, so the
+ * rendered frames are shown by the training thread itself, which only
+ * costs an imshow of a ready image.
+ *
+ * When $VISUALIZER_OUTPUT is set, nothing is shown and the frame of the
+ * end of each epoch is written as a PNG file in this directory.
+ */
+
+#ifndef ASYNC_VISUALIZER_HPP
+#define ASYNC_VISUALIZER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "dll/watcher.hpp"
+
+#include "dbn_convert.hpp"
+
+template<std::size_t Scale = 3, std::size_t BatchFrequency = 10>
+struct async_ocv_config {
+    static constexpr const std::size_t scale = Scale;                    ///< Size of a weight, in pixels
+    static constexpr const std::size_t batch_frequency = BatchFrequency; ///< A snapshot every batch_frequency batches (not in headless mode)
+};
+
+/*!
+ * \brief Filters of a layer, count tiles of side x side weights
+ */
+struct filter_frame {
+    std::size_t layer = 0;
+    std::size_t epoch = 0;
+    std::size_t count = 0;
+    std::size_t side = 0;
+    std::vector<float> weights;
+};
+
+namespace visualizer_detail {
+
+template<typename T, typename Enable = void>
+struct has_conv_shape : std::false_type {};
+
+template<typename T>
+struct has_conv_shape<T, decltype(void(T::NC + T::NV + T::NH + T::K))> : std::true_type {};
+
+//Dense RBM: one tile per hidden unit, the visible units being arranged in a square
+template<typename RBM, std::enable_if_t<convert_detail::is_dense_rbm<RBM>::value, int> = 0>
+void snapshot(const RBM& rbm, filter_frame& frame){
+    frame.count = RBM::num_hidden;
+    frame.side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(RBM::num_visible))));
+    frame.weights.assign(frame.count * frame.side * frame.side, 0.0f);
+
+    for(std::size_t j = 0; j < RBM::num_hidden; ++j){
+        auto tile = &frame.weights[j * frame.side * frame.side];
+        for(std::size_t i = 0; i < RBM::num_visible; ++i){
+            tile[i] = rbm.w(i, j);
+        }
+    }
+}
+
+//Convolutional RBM: one tile per filter, of the first channel
+template<typename RBM, std::enable_if_t<has_conv_shape<RBM>::value, int> = 0>
+void snapshot(const RBM& rbm, filter_frame& frame){
+    frame.count = RBM::K;
+    frame.side = RBM::NV - RBM::NH + 1;
+    frame.weights.resize(frame.count * frame.side * frame.side);
+
+    auto out = frame.weights.begin();
+    for(std::size_t k = 0; k < RBM::K; ++k){
+        for(std::size_t a = 0; a < frame.side; ++a){
+            for(std::size_t b = 0; b < frame.side; ++b){
+                *out++ = rbm.w(0, k, a, b);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Draw the tiles in a square grid, each tile scaled to its own range
+ */
+inline cv::Mat render(const filter_frame& frame, std::size_t scale){
+    auto columns = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(frame.count))));
+    auto rows = (frame.count + columns - 1) / columns;
+    auto tile = frame.side * scale + 1;
+
+    cv::Mat image(rows * tile + 1, columns * tile + 1, CV_8UC1, cv::Scalar(255));
+
+    for(std::size_t t = 0; t < frame.count; ++t){
+        auto first = frame.weights.begin() + t * frame.side * frame.side;
+        auto last = first + frame.side * frame.side;
+
+        auto mm = std::minmax_element(first, last);
+        auto min = *mm.first;
+        auto range = *mm.second > min ? *mm.second - min : 1.0f;
+
+        auto left = (t % columns) * tile + 1;
+        auto top = (t / columns) * tile + 1;
+
+        for(std::size_t y = 0; y < frame.side * scale; ++y){
+            auto row = image.ptr<uint8_t>(top + y) + left;
+            auto weights = first + (y / scale) * frame.side;
+
+            for(std::size_t x = 0; x < frame.side * scale; ++x){
+                row[x] = static_cast<uint8_t>(255.0f * (weights[x / scale] - min) / range);
+            }
+        }
+    }
+
+    return image;
+}
+
+} //end of namespace visualizer_detail
+
+/*!
+ * \brief Render thread fed through a double buffer.
+ *
+ * submit() only copies the weights into the back buffer. If the
+ * previous snapshot was not rendered yet, it is replaced (dropped),
+ * except in headless mode where submit() waits for it. show() displays the last rendered frame, if any, and must be called
+ * from the thread using HighGUI.
+ */
+template<typename C>
+struct async_renderer {
+    async_renderer(){
+        auto output = std::getenv("VISUALIZER_OUTPUT");
+
+        headless = output != nullptr;
+
+        if(headless){
+            directory = output;
+            mkdir(directory.c_str(), 0755);
+        }
+
+        thread = std::thread([this]{ run(); });
+    }
+
+    async_renderer(const async_renderer&) = delete;
+    async_renderer& operator=(const async_renderer&) = delete;
+
+    ~async_renderer(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+
+        condition.notify_one();
+        thread.join();
+
+        show();
+
+        if(dropped){
+            std::cout << "visualizer: " << rendered << " frames rendered, " << dropped << " dropped" << std::endl;
+        }
+    }
+
+    template<typename RBM>
+    void submit(const RBM& rbm, std::size_t layer, std::size_t epoch){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            //Only the ends of epochs are written in headless mode, none of them is dropped
+            if(headless){
+                condition.wait(lock, [this]{ return !pending; });
+            }
+
+            dropped += pending;
+
+            back.layer = layer;
+            back.epoch = epoch;
+            visualizer_detail::snapshot(rbm, back);
+
+            pending = true;
+        }
+
+        condition.notify_one();
+    }
+
+    void show(){
+        if(headless){
+            return;
+        }
+
+        cv::Mat image;
+        std::size_t layer;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if(!ready){
+                return;
+            }
+
+            std::swap(image, ready_image);
+            layer = ready_layer;
+            ready = false;
+        }
+
+        cv::imshow("Layer " + std::to_string(layer), image);
+        cv::waitKey(1);
+    }
+
+    bool is_headless() const {
+        return headless;
+    }
+
+private:
+    void run(){
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]{ return pending || done; });
+
+                //The last snapshot is rendered even when training is done
+                if(!pending){
+                    break;
+                }
+
+                std::swap(front, back);
+                pending = false;
+            }
+
+            condition.notify_all();
+
+            auto image = visualizer_detail::render(front, C::scale);
+
+            if(headless){
+                char name[64];
+                std::snprintf(name, sizeof(name), "/layer_%zu_epoch_%04zu.png", front.layer, front.epoch);
+                cv::imwrite(directory + name, image);
+            } else {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                //A rendered frame not shown in time is dropped as well
+                dropped += ready;
+
+                ready_image = image;
+                ready_layer = front.layer;
+                ready = true;
+            }
+
+            ++rendered;
+        }
+    }
+
+    bool headless;
+    std::string directory;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    filter_frame front;
+    filter_frame back;
+    cv::Mat ready_image;
+    std::size_t ready_layer = 0;
+    bool ready = false;
+    bool pending = false;
+    bool done = false;
+    std::size_t rendered = 0;
+    std::size_t dropped = 0;
+
+    std::thread thread;
+};
+
+/*!
+ * \brief RBM watcher showing the filters asynchronously, at the end of
+ * each epoch and every C::batch_frequency batches. In headless mode,
+ * only the end of each epoch is written.
+ */
+template<typename RBM, typename C = async_ocv_config<>>
+struct async_rbm_visualizer : dll::default_rbm_watcher<RBM> {
+    using base_type = dll::default_rbm_watcher<RBM>;
+
+    async_renderer<C> renderer;
+    std::size_t epoch = 0;
+
+    void epoch_end(std::size_t epoch, double error, double free_energy, const RBM& rbm){
+        base_type::epoch_end(epoch, error, free_energy, rbm);
+
+        this->epoch = epoch + 1;
+        renderer.submit(rbm, 0, epoch);
+        renderer.show();
+    }
+
+    template<typename Context>
+    void batch_end(const RBM& rbm, const Context& /*context*/, std::size_t batch, std::size_t /*batches*/){
+        if(!renderer.is_headless() && batch % C::batch_frequency == 0){
+            renderer.submit(rbm, 0, epoch);
+            renderer.show();
+        }
+    }
+};
+
+/*!
+ * \brief DBN watcher showing the filters of the layer being pretrained
+ * asynchronously, one window per layer.
+ *
+ * dll creates a new watcher for each layer, the layer being trained is
+ * therefore counted per DBN type, from the beginning of each
+ * pretraining.
+ */
+template<typename DBN, typename C = async_ocv_config<>>
+struct async_dbn_visualizer : dll::default_dbn_watcher<DBN> {
+    static constexpr const bool replace_sub = true;
+
+    async_renderer<C> renderer;
+    std::size_t epoch = 0;
+
+    static std::size_t& layer(){
+        static std::size_t layer = 0;
+        return layer;
+    }
+
+    template<typename... Args>
+    void pretraining_begin(const DBN& dbn, Args&&... args){
+        layer() = 0;
+
+        dll::default_dbn_watcher<DBN>::pretraining_begin(dbn, std::forward<Args>(args)...);
+    }
+
+    template<typename RBM>
+    void training_begin(const RBM& /*rbm*/){
+        epoch = 0;
+    }
+
+    template<typename RBM>
+    void epoch_end(std::size_t epoch, double error, double free_energy, const RBM& rbm){
+        std::printf("epoch %zu - Reconstruction error: %.5f - Free energy: %.3f\n", epoch, error, free_energy);
+
+        this->epoch = epoch + 1;
+        renderer.submit(rbm, layer(), epoch);
+        renderer.show();
+    }
+
+    template<typename RBM, typename Context>
+    void batch_end(const RBM& rbm, const Context& /*context*/, std::size_t batch, std::size_t /*batches*/){
+        if(!renderer.is_headless() && batch % C::batch_frequency == 0){
+            renderer.submit(rbm, layer(), epoch);
+            renderer.show();
+        }
+    }
+
+    template<typename RBM>
+    void training_end(const RBM& /*rbm*/){
+        ++layer();
+    }
+};
+
+#endif
@@ -0,0 +1,192 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file bench.hpp
+ * \brief Throughput measurement for the benchmark drivers.
+ *
+ * Each phase (pretraining, fine-tuning, inference) is
+ * run warmup times and then timed reps times. The samples/s of the
+ * repetitions are reported as JSON, on the standard output or in the
+ * --output file.
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Options of a benchmark driver:
+ * --samples N, --warmup N, --reps N, --epochs N, --output file
+ */
+struct bench_options {
+    std::size_t samples = 1000;
+    std::size_t warmup = 1;
+    std::size_t reps = 3;
+    std::size_t epochs = 1; ///< Epochs of one timed training run
+    std::string output;
+
+    static bench_options parse(int argc, char* argv[]){
+        bench_options options;
+
+        for(int i = 1; i + 1 < argc; i += 2){
+            std::string option(argv[i]);
+            std::string value(argv[i + 1]);
+
+            if(option == "--samples"){
+                options.samples = std::stoul(value);
+            } else if(option == "--warmup"){
+                options.warmup = std::stoul(value);
+            } else if(option == "--reps"){
+                options.reps = std::max(1ul, std::stoul(value));
+            } else if(option == "--epochs"){
+                options.epochs = std::max(1ul, std::stoul(value));
+            } else if(option == "--output"){
+                options.output = value;
+            } else {
+                std::cerr << "Unknown option " << option << std::endl;
+            }
+        }
+
+        return options;
+    }
+};
+
+/*!
+ * \brief The timings of one phase of one configuration
+ */
+struct bench_result {
+    std::string config;
+    std::string phase;
+    std::size_t samples;         ///< Samples processed by one repetition
+    std::vector<double> seconds; ///< Duration of each repetition
+};
+
+struct bench_report {
+    std::string benchmark;
+    bench_options options;
+    std::vector<bench_result> results;
+
+    bench_report(std::string benchmark, bench_options options) : benchmark(std::move(benchmark)), options(std::move(options)) {}
+
+    /*!
+     * \brief Time functor(), which processes samples samples
+     */
+    template<typename Functor>
+    void measure(const std::string& config, const std::string& phase, std::size_t samples, Functor&& functor){
+        for(std::size_t i = 0; i < options.warmup; ++i){
+            functor();
+        }
+
+        bench_result result{config, phase, samples, {}};
+
+        for(std::size_t i = 0; i < options.reps; ++i){
+            auto start = std::chrono::steady_clock::now();
+            functor();
+            auto end = std::chrono::steady_clock::now();
+
+            result.seconds.push_back(std::chrono::duration<double>(end - start).count());
+        }
+
+        std::cerr << benchmark << " " << config << " " << phase << ": " << samples / median(result.seconds) << " samples/s" << std::endl;
+
+        results.push_back(std::move(result));
+    }
+
+    void write(std::ostream& os) const {
+        os << "{\n";
+        os << "  \"benchmark\": \"" << benchmark << "\",\n";
+        os << "  \"warmup\": " << options.warmup << ",\n";
+        os << "  \"reps\": " << options.reps << ",\n";
+        os << "  \"results\": [";
+
+        for(std::size_t i = 0; i < results.size(); ++i){
+            auto& result = results[i];
+
+            std::vector<double> rates;
+            for(auto s : result.seconds){
+                rates.push_back(s > 0.0 ? result.samples / s : 0.0);
+            }
+
+            double mean = 0.0;
+            for(auto r : rates){
+                mean += r / rates.size();
+            }
+
+            os << (i ? "," : "") << "\n    {\n";
+            os << "      \"config\": \"" << result.config << "\",\n";
+            os << "      \"phase\": \"" << result.phase << "\",\n";
+            os << "      \"samples\": " << result.samples << ",\n";
+            os << "      \"samples_per_second\": {"
+               << "\"mean\": " << mean
+               << ", \"median\": " << median(rates)
+               << ", \"min\": " << *std::min_element(rates.begin(), rates.end())
+               << ", \"max\": " << *std::max_element(rates.begin(), rates.end()) << "},\n";
+            os << "      \"seconds\": [";
+            for(std::size_t r = 0; r < result.seconds.size(); ++r){
+                os << (r ? ", " : "") << result.seconds[r];
+            }
+            os << "]\n    }";
+        }
+
+        os << "\n  ]\n}\n";
+    }
+
+    /*!
+     * \brief Write the report to the output file, or to the standard output
+     */
+    void finish() const {
+        if(options.output.empty()){
+            write(std::cout);
+        } else {
+            std::ofstream os(options.output);
+            write(os);
+        }
+    }
+
+private:
+    static double median(std::vector<double> values){
+        std::sort(values.begin(), values.end());
+        auto n = values.size();
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+    }
+};
+
+/*!
+ * \brief Watcher (for RBMs and DBNs) that prints nothing, so that the
+ * standard output only contains the report and the output does not
+ * weigh on the timings.
+ */
+template<typename T>
+struct silent_watcher {
+    static constexpr const bool ignore_sub = false;
+    static constexpr const bool replace_sub = true;
+
+    template<typename... Args> void training_begin(Args&&...){}
+    template<typename... Args> void epoch_end(Args&&...){}
+    template<typename... Args> void batch_end(Args&&...){}
+    template<typename... Args> void training_end(Args&&...){}
+
+    template<typename... Args> void pretraining_begin(Args&&...){}
+    template<typename RBM, typename... Args> void pretrain_layer(Args&&...){}
+    template<typename... Args> void pretraining_batch(Args&&...){}
+    template<typename... Args> void pretraining_end(Args&&...){}
+
+    template<typename... Args> void fine_tuning_begin(Args&&...){}
+    template<typename... Args> void ft_epoch_end(Args&&...){}
+    template<typename... Args> void ft_batch_end(Args&&...){}
+    template<typename... Args> void fine_tuning_end(Args&&...){}
+};
+
+#endif
@@ -0,0 +1,101 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Throughput of the conv_dbn_mnist stacks, plain and with max pooling
+ */
+
+#include <iostream>
+#include <memory>
+
+#include "dll/conv_rbm.hpp"
+#include "dll/conv_rbm_mp.hpp"
+#include "dll/dbn.hpp"
+
+#include "bench.hpp"
+#include "dbn_convert.hpp"
+#include "feature_matrix.hpp"
+#include "mnist_cache.hpp"
+
+namespace {
+
+template<typename DBN, typename Images>
+void bench_dbn(bench_report& report, const std::string& config, DBN& dbn, Images& images){
+    auto n = images.size();
+    auto epochs = report.options.epochs;
+
+    dbn.template layer_get<0>().pbias = 0.05;
+    dbn.template layer_get<0>().pbias_lambda = 50;
+
+    dbn.template layer_get<1>().pbias = 0.05;
+    dbn.template layer_get<1>().pbias_lambda = 100;
+
+    report.measure(config, "pretraining", n * epochs, [&]{
+        dbn.pretrain(images, epochs);
+    });
+
+    std::vector<float> features(DBN::output_size());
+
+    report.measure(config, "inference", n, [&]{
+        for(auto& image : images){
+            dbn.activation_probabilities(image, features);
+        }
+    });
+
+    //The parallel engine only supports the stacks without pooling
+    auto network = make_conv_network(dbn);
+
+    if(!network.empty()){
+        feature_matrix output;
+        output.resize(n, network.output_size());
+
+        report.measure(config, "inference_batched", n, [&]{
+            conv_extract(network, images, output);
+        });
+    }
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    auto options = bench_options::parse(argc, argv);
+
+    auto dataset = read_cached_dataset_direct<std::vector, etl::fast_dyn_matrix<double, 1, 28, 28>>(options.samples, cache_mode::BINARIZE);
+
+    if(dataset.training_images.empty()){
+        std::cerr << "Impossible to read dataset" << std::endl;
+        return 1;
+    }
+
+    bench_report report("conv_dbn_mnist", options);
+
+    {
+        typedef dll::dbn_desc<
+            dll::dbn_layers<
+            dll::conv_rbm_desc_square<1, 28, 40, 17, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+            dll::conv_rbm_desc_square<40, 17, 40, 12, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                >, dll::watcher<silent_watcher>>::dbn_t dbn_t;
+
+        auto dbn = std::make_unique<dbn_t>();
+        bench_dbn(report, "plain", *dbn, dataset.training_images);
+    }
+
+    {
+        typedef dll::dbn_desc<
+            dll::dbn_layers<
+            dll::conv_rbm_mp_desc_square<1, 28, 40, 18, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+            dll::conv_rbm_mp_desc_square<40, 9, 40, 6, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                >, dll::watcher<silent_watcher>>::dbn_t dbn_t;
+
+        auto dbn = std::make_unique<dbn_t>();
+        bench_dbn(report, "mp", *dbn, dataset.training_images);
+    }
+
+    report.finish();
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Throughput of the crbm_mnist 28/16/40 convolutional RBM
+ */
+
+#include <iostream>
+#include <vector>
+
+#include "dll/conv_rbm.hpp"
+
+#include "bench.hpp"
+#include "mnist_cache.hpp"
+
+int main(int argc, char* argv[]){
+    auto options = bench_options::parse(argc, argv);
+
+    auto dataset = read_cached_dataset<double>(options.samples, cache_mode::BINARIZE);
+
+    if(dataset.training_images.empty()){
+        std::cerr << "Impossible to read dataset" << std::endl;
+        return 1;
+    }
+
+    auto n = dataset.training_images.size();
+
+    bench_report report("crbm_mnist", options);
+
+    dll::conv_rbm_desc_square<
+        1, 28, 40, 16,
+        dll::batch_size<25>,
+        dll::visible<dll::unit_type::BINARY>,
+        dll::watcher<silent_watcher>
+        >::layer_t rbm;
+
+    report.measure("28-16-40", "pretraining", n * options.epochs, [&]{
+        rbm.train(dataset.training_images, options.epochs);
+    });
+
+    std::vector<float> hiddens(rbm.output_size());
+
+    report.measure("28-16-40", "inference", n, [&]{
+        for(auto& image : dataset.training_images){
+            rbm.activation_probabilities(image, hiddens);
+        }
+    });
+
+    report.finish();
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Throughput of the dbn_mnist 784-300-500-10 stack
+ */
+
+#include <iostream>
+#include <memory>
+
+#include "dll/rbm.hpp"
+#include "dll/dbn.hpp"
+
+#include "bench.hpp"
+#include "dbn_convert.hpp"
+#include "evaluation.hpp"
+#include "mnist_cache.hpp"
+
+int main(int argc, char* argv[]){
+    auto options = bench_options::parse(argc, argv);
+
+    auto dataset = read_cached_dataset<float>(options.samples, cache_mode::NORMALIZE);
+
+    if(dataset.training_images.empty() || dataset.training_labels.empty()){
+        std::cerr << "Impossible to read dataset" << std::endl;
+        return 1;
+    }
+
+    auto& images = dataset.training_images;
+    auto& labels = dataset.training_labels;
+    auto n = images.size();
+
+    bench_report report("dbn_mnist", options);
+
+    typedef dll::dbn_desc<
+        dll::dbn_layers<
+        dll::rbm_desc<28 * 28, 300, dll::momentum, dll::batch_size<100>, dll::init_weights, dll::visible<dll::unit_type::GAUSSIAN>>::layer_t,
+        dll::rbm_desc<300, 500, dll::momentum, dll::batch_size<100>>::layer_t,
+        dll::rbm_desc<500, 10, dll::momentum, dll::batch_size<100>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+            >, dll::watcher<silent_watcher>>::dbn_t dbn_t;
+
+    auto dbn = std::make_unique<dbn_t>();
+
+    report.measure("784-300-500-10", "pretraining", n * options.epochs, [&]{
+        dbn->pretrain(images, options.epochs);
+    });
+
+    report.measure("784-300-500-10", "fine_tuning", n * options.epochs, [&]{
+        dbn->fine_tune(images, labels, options.epochs);
+    });
+
+    report.measure("784-300-500-10", "inference", n, [&]{
+        for(auto& image : images){
+            dbn->predict(image);
+        }
+    });
+
+    auto network = make_dense_network(*dbn);
+
+    report.measure("784-300-500-10", "inference_batched", n, [&]{
+        dense_test_set(network, images, labels);
+    });
+
+    auto quantized = quantize_network(network, images);
+
+    report.measure("784-300-500-10", "inference_int8", n, [&]{
+        quantized_test_set(quantized, images, labels);
+    });
+
+    report.finish();
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file binary_dataset.hpp
+ * \brief Bit-packed binary images and the first-layer kernel using them.
+ *
+ * Once binarized, every pixel is 0 or 1, so an image is stored as one
+ * bit per pixel (98 bytes for a MNIST image instead of 3136 as float).
+ * For binary visible units, the input of a hidden unit is its bias plus
+ * the sum of the weights of the visible units that are on: the first
+ * layer adds the weight rows of the set bits instead of multiplying the
+ * whole input by the weights.
+ */
+
+#ifndef BINARY_DATASET_HPP
+#define BINARY_DATASET_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "dense_network.hpp"
+#include "parallel.hpp"
+
+/*!
+ * \brief A set of binary images, each packed in stride bytes.
+ *
+ * The pixel p of an image is the bit p % 8 of its byte p / 8.
+ */
+struct binary_images {
+    std::size_t pixels = 0;
+    std::size_t stride = 0;
+    std::vector<uint8_t> bits;
+
+    binary_images() = default;
+    explicit binary_images(std::size_t pixels) : pixels(pixels), stride((pixels + 7) / 8) {}
+
+    std::size_t size() const {
+        return stride ? bits.size() / stride : 0;
+    }
+
+    bool empty() const {
+        return bits.empty();
+    }
+
+    const uint8_t* operator[](std::size_t i) const {
+        return bits.data() + i * stride;
+    }
+
+    bool get(std::size_t i, std::size_t p) const {
+        return (bits[i * stride + p / 8] >> (p % 8)) & 1;
+    }
+
+    /*!
+     * \brief Pack an image, every non-zero pixel being on
+     */
+    template<typename Image>
+    void push_back(const Image& image){
+        auto first = bits.size();
+        bits.resize(first + stride, 0);
+
+        auto out = &bits[first];
+        for(std::size_t p = 0; p < pixels; ++p){
+            out[p / 8] |= static_cast<uint8_t>(image[p] != 0) << (p % 8);
+        }
+    }
+
+    /*!
+     * \brief Unpack the image i into pixels values (0 or 1)
+     */
+    template<typename T>
+    void unpack(std::size_t i, T* image) const {
+        for(std::size_t p = 0; p < pixels; ++p){
+            image[p] = get(i, p);
+        }
+    }
+};
+
+/*!
+ * \brief A binarized dataset with packed images, with the same member
+ * names as mnist::MNIST_dataset.
+ */
+struct binary_dataset {
+    binary_images training_images;
+    binary_images test_images;
+    std::vector<uint8_t> training_labels;
+    std::vector<uint8_t> test_labels;
+};
+
+/*!
+ * \brief Pack a binarized dataset (for instance a cached_dataset in
+ * cache_mode::BINARIZE).
+ */
+template<typename Dataset>
+binary_dataset pack_dataset(const Dataset& dataset){
+    binary_dataset packed;
+
+    auto pack = [](const auto& images, binary_images& out){
+        out = binary_images(images.empty() ? 0 : images[0].size());
+        out.bits.reserve(images.size() * out.stride);
+
+        for(auto& image : images){
+            out.push_back(image);
+        }
+    };
+
+    pack(dataset.training_images, packed.training_images);
+    pack(dataset.test_images, packed.test_images);
+
+    packed.training_labels.assign(dataset.training_labels.begin(), dataset.training_labels.end());
+    packed.test_labels.assign(dataset.test_labels.begin(), dataset.test_labels.end());
+
+    return packed;
+}
+
+namespace binary_detail {
+
+inline void add_row(const dense_layer& layer, std::size_t k, float* out){
+    auto w = layer.weights + k * layer.outputs;
+
+    for(std::size_t j = 0; j < layer.outputs; ++j){
+        out[j] += w[j];
+    }
+}
+
+} //end of namespace binary_detail
+
+/*!
+ * \brief Compute the activation probabilities of a layer with binary
+ * inputs for the packed images [first, last).
+ *
+ * The image is read 64 bits at a time and only the rows of the weights
+ * of the set bits are added, an all-zero word costing a single test.
+ */
+inline void binary_layer_forward(const dense_layer& layer, const binary_images& images, std::size_t first, std::size_t last, float* output){
+    auto n_out = layer.outputs;
+    auto full_words = images.pixels / 64;
+
+    for(std::size_t i = first; i < last; ++i){
+        auto image = images[i];
+        auto out = output + (i - first) * n_out;
+
+        std::copy(layer.biases, layer.biases + n_out, out);
+
+        for(std::size_t w = 0; w < full_words; ++w){
+            uint64_t word;
+            std::memcpy(&word, image + w * 8, sizeof(word));
+
+            while(word){
+                binary_detail::add_row(layer, w * 64 + __builtin_ctzll(word), out);
+                word &= word - 1;
+            }
+        }
+
+        for(std::size_t p = full_words * 64; p < images.pixels; ++p){
+            if((image[p / 8] >> (p % 8)) & 1){
+                binary_detail::add_row(layer, p, out);
+            }
+        }
+    }
+
+    dense_detail::activate(layer.activation, output, last - first, n_out);
+}
+
+/*!
+ * \brief Propagate the packed images [first, last) through the network,
+ * the first layer using the binary kernel.
+ */
+inline void binary_forward(const dense_network& network, const binary_images& images, std::size_t first, std::size_t last, float* output, dense_workspace& workspace){
+    auto batch = last - first;
+
+    workspace.prepare(network, batch);
+
+    float* current = network.layers.size() == 1 ? output : workspace.a.data();
+
+    binary_layer_forward(network.layers[0], images, first, last, current);
+
+    for(std::size_t l = 1; l < network.layers.size(); ++l){
+        float* next = l + 1 == network.layers.size() ? output : (l % 2 == 0 ? workspace.a.data() : workspace.b.data());
+
+        dense_layer_forward(network.layers[l], current, batch, next);
+
+        current = next;
+    }
+}
+
+/*!
+ * \brief Compute the error rate of a dense network on packed images.
+ */
+template<typename Labels>
+double binary_test_set(const dense_network& network, const binary_images& images, const Labels& labels){
+    constexpr const std::size_t batch_size = 256;
+
+    auto threads = default_threads();
+
+    std::vector<std::size_t> errors(threads, 0);
+
+    parallel_for_batches(images.size(), batch_size, [&](std::size_t first, std::size_t last, std::size_t thread){
+        std::vector<float> output((last - first) * network.output_size());
+        dense_workspace workspace;
+
+        binary_forward(network, images, first, last, output.data(), workspace);
+
+        for(std::size_t i = first; i < last; ++i){
+            if(dense_argmax(&output[(i - first) * network.output_size()], network.output_size()) != labels[i]){
+                ++errors[thread];
+            }
+        }
+    }, threads);
+
+    std::size_t total = 0;
+    for(auto e : errors){
+        total += e;
+    }
+
+    return images.empty() ? 0.0 : static_cast<double>(total) / images.size();
+}
+
+#endif
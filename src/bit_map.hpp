@@ -0,0 +1,245 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file bit_map.hpp
+ * \brief Bit-packed binary maps and their morphology.
+ */
+
+#ifndef BIT_MAP_HPP
+#define BIT_MAP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief Binary image, one bit per pixel, each row padded to 64 bits.
+ *
+ * The padding bits of each row are always zero.
+ */
+struct bit_map {
+    std::size_t width = 0;
+    std::size_t height = 0;
+    std::size_t words_per_row = 0;
+    std::vector<uint64_t> bits;
+
+    bit_map() = default;
+
+    bit_map(std::size_t width, std::size_t height) : width(width), height(height), words_per_row((width + 63) / 64), bits(words_per_row * height, 0) {}
+
+    bool get(std::size_t x, std::size_t y) const {
+        return (bits[y * words_per_row + x / 64] >> (x % 64)) & 1;
+    }
+
+    void set(std::size_t x, std::size_t y){
+        bits[y * words_per_row + x / 64] |= uint64_t(1) << (x % 64);
+    }
+
+    uint64_t* row(std::size_t y){
+        return &bits[y * words_per_row];
+    }
+
+    const uint64_t* row(std::size_t y) const {
+        return &bits[y * words_per_row];
+    }
+
+    /*!
+     * \brief Set the row y from width bytes, non-zero bytes being set bits
+     */
+    void pack_row(std::size_t y, const uint8_t* values){
+        auto r = row(y);
+
+        for(std::size_t w = 0; w < words_per_row; ++w){
+            auto first = w * 64;
+            auto n = std::min<std::size_t>(64, width - first);
+
+            uint64_t word = 0;
+            for(std::size_t i = 0; i < n; ++i){
+                word |= uint64_t(values[first + i] != 0) << i;
+            }
+
+            r[w] = word;
+        }
+    }
+
+    /*!
+     * \brief Write the row y as width bytes, on for set bits and off otherwise
+     */
+    void unpack_row(std::size_t y, uint8_t* values, uint8_t on = 255, uint8_t off = 0) const {
+        auto r = row(y);
+
+        for(std::size_t x = 0; x < width; ++x){
+            values[x] = (r[x / 64] >> (x % 64)) & 1 ? on : off;
+        }
+    }
+
+    bit_map& operator|=(const bit_map& rhs){
+        for(std::size_t i = 0; i < bits.size(); ++i){
+            bits[i] |= rhs.bits[i];
+        }
+
+        return *this;
+    }
+};
+
+/*!
+ * \brief Structuring element, as the half-width of its span for each
+ * row offset in [-radius, radius].
+ */
+struct structuring_element {
+    std::size_t radius = 0;
+    std::vector<std::size_t> spans; ///< 2 * radius + 1 half-widths
+
+    /*!
+     * \brief The (2 * radius + 1) x (2 * radius + 1) ellipse, with the same
+     * rows as cv::getStructuringElement(cv::MORPH_ELLIPSE)
+     */
+    static structuring_element ellipse(std::size_t radius){
+        structuring_element element;
+        element.radius = radius;
+
+        double r = radius;
+
+        for(std::size_t i = 0; i <= 2 * radius; ++i){
+            double dy = static_cast<double>(i) - r;
+            element.spans.push_back(radius == 0 ? 0 : std::lrint(r * std::sqrt((r * r - dy * dy) / (r * r))));
+        }
+
+        return element;
+    }
+};
+
+namespace bit_map_detail {
+
+//Row of the given map with the padding bits set to fill
+inline void load_row(const bit_map& map, std::size_t y, uint64_t* out, uint64_t fill){
+    std::copy(map.row(y), map.row(y) + map.words_per_row, out);
+
+    if(map.width % 64){
+        out[map.words_per_row - 1] |= fill & (~uint64_t(0) << (map.width % 64));
+    }
+}
+
+//out[x] = in[x + d], pixels outside the row being fill
+inline void shift_row(const uint64_t* in, uint64_t* out, std::size_t words, long d, uint64_t fill){
+    auto q = static_cast<long>(d >= 0 ? d : -d) / 64;
+    auto r = static_cast<unsigned>((d >= 0 ? d : -d) % 64);
+
+    auto word = [&](long i){ return i >= 0 && i < static_cast<long>(words) ? in[i] : fill; };
+
+    for(long i = 0; i < static_cast<long>(words); ++i){
+        if(d >= 0){
+            out[i] = r ? (word(i + q) >> r) | (word(i + q + 1) << (64 - r)) : word(i + q);
+        } else {
+            out[i] = r ? (word(i - q) << r) | (word(i - q - 1) >> (64 - r)) : word(i - q);
+        }
+    }
+}
+
+/*!
+ * \brief Erosion (min) or dilation (max) by the structuring element,
+ * pixels outside the map being 1 for erosion and 0 for dilation.
+ *
+ * Each row is first eroded (or dilated) horizontally once for each
+ * distinct span, then the rows of the spans are combined vertically.
+ */
+inline bit_map morphology(const bit_map& source, const structuring_element& element, bool erode){
+    auto words = source.words_per_row;
+    auto fill = erode ? ~uint64_t(0) : uint64_t(0);
+    auto radius = static_cast<long>(element.radius);
+    auto max_span = *std::max_element(element.spans.begin(), element.spans.end());
+
+    //Horizontal pass, horizontal[s] is the map combined with span s
+    std::vector<std::vector<uint64_t>> horizontal(max_span + 1);
+
+    for(auto span : element.spans){
+        horizontal[span].resize(words * source.height);
+    }
+
+    std::vector<uint64_t> row(words);
+    std::vector<uint64_t> current(words);
+    std::vector<uint64_t> shifted(words);
+
+    for(std::size_t y = 0; y < source.height; ++y){
+        load_row(source, y, row.data(), fill);
+        std::copy(row.begin(), row.end(), current.begin());
+
+        for(std::size_t s = 0; s <= max_span; ++s){
+            if(s > 0){
+                for(long d : {static_cast<long>(s), -static_cast<long>(s)}){
+                    shift_row(row.data(), shifted.data(), words, d, fill);
+
+                    for(std::size_t w = 0; w < words; ++w){
+                        current[w] = erode ? current[w] & shifted[w] : current[w] | shifted[w];
+                    }
+                }
+            }
+
+            if(!horizontal[s].empty()){
+                std::copy(current.begin(), current.end(), horizontal[s].begin() + y * words);
+            }
+        }
+    }
+
+    //Vertical pass
+    bit_map result(source.width, source.height);
+
+    auto last_mask = source.width % 64 ? ~uint64_t(0) >> (64 - source.width % 64) : ~uint64_t(0);
+
+    for(std::size_t y = 0; y < source.height; ++y){
+        auto out = result.row(y);
+        std::fill(out, out + words, fill);
+
+        for(long dy = -radius; dy <= radius; ++dy){
+            auto yy = static_cast<long>(y) + dy;
+
+            if(yy < 0 || yy >= static_cast<long>(source.height)){
+                continue;
+            }
+
+            auto in = &horizontal[element.spans[dy + radius]][yy * words];
+
+            for(std::size_t w = 0; w < words; ++w){
+                out[w] = erode ? out[w] & in[w] : out[w] | in[w];
+            }
+        }
+
+        if(words){
+            out[words - 1] &= last_mask;
+        }
+    }
+
+    return result;
+}
+
+} //end of namespace bit_map_detail
+
+inline bit_map erode(const bit_map& source, const structuring_element& element){
+    return bit_map_detail::morphology(source, element, true);
+}
+
+inline bit_map dilate(const bit_map& source, const structuring_element& element){
+    return bit_map_detail::morphology(source, element, false);
+}
+
+/*!
+ * \brief Morphological opening, same as cv::MORPH_OPEN with default borders
+ */
+inline bit_map morph_open(const bit_map& source, const structuring_element& element){
+    return dilate(erode(source, element), element);
+}
+
+/*!
+ * \brief Morphological closing, same as cv::MORPH_CLOSE with default borders
+ */
+inline bit_map morph_close(const bit_map& source, const structuring_element& element){
+    return erode(dilate(source, element), element);
+}
+
+#endif
@@ -20,6 +20,15 @@
 
 #include "icdar/icdar_reader.hpp"
 
+#include "dbn_convert.hpp"
+#include "feature_matrix.hpp"
+#include "feature_scaler.hpp"
+#include "icdar_windows.hpp"
+#include "label_mask.hpp"
+#include "location_sampler.hpp"
+#include "planar_image.hpp"
+#include "reservoir.hpp"
+
 #include <opencv2/opencv.hpp>
 
 constexpr const std::size_t deep_context = 5;
@@ -29,96 +38,84 @@ constexpr const std::size_t large_window = 40;
 constexpr const std::size_t large_filter = 8;
 constexpr const std::size_t large_features = 40;
 
-template<typename Label>
-bool is_text(const Label& label, std::size_t x, std::size_t y){
-    for(auto& rectangle : label.rectangles){
-        if(x >= rectangle.left && x <= rectangle.right && y >= rectangle.top && y <= rectangle.bottom){
-            return true;
-        }
-    }
-
-    return false;
-}
+/*!
+ * \brief Select limit windows uniformly at random from all the interior pixels of the images.
+ *
+ * The population is streamed through a reservoir, so memory only
+ * depends on limit. In stratified mode, half of the windows are text
+ * pixels and half are background pixels.
+ *
+ * \return The number of windows in the population
+ */
+template<typename Images, typename RNG>
+std::size_t deep_sample(window_dataset<Images>& windows, std::vector<std::size_t>& labels, const Images& d_images, const std::vector<label_mask>& masks, std::size_t limit, bool stratified, RNG& g){
+    using sample_t = std::pair<window_ref, std::size_t>;
+
+    reservoir_sampler<sample_t> sampler(limit);
+    stratified_sampler<sample_t> s_sampler(limit, 2);
 
-template<typename Images, typename Labels>
-void deep_extract(std::vector<std::vector<float>>& windows, std::vector<std::size_t>& labels, Images& d_images, Labels& d_labels){
     for(std::size_t image_id = 0; image_id < d_images.size(); ++image_id){
         auto& image = d_images[image_id];
+        auto& mask = masks[image_id];
 
-        windows.reserve(windows.size() + image.width * image.height);
+        for(std::size_t y = deep_context; y < image.height - deep_context; ++y){
+            for(std::size_t x = deep_context; x < image.width - deep_context; ++x){
+                window_ref window{static_cast<uint32_t>(image_id), static_cast<uint32_t>(x), static_cast<uint32_t>(y)};
 
-        for(std::size_t i = deep_context; i < image.width - deep_context; ++i){
-            for(std::size_t j = deep_context; j < image.height - deep_context; ++j){
-
-                windows.emplace_back(deep_window * deep_window);
-
-                labels.push_back(is_text(d_labels[image_id], i, j) ? 1 : 0);
-
-                for(std::size_t a = i - deep_context; a < i - deep_context + deep_window; ++a){
-                    for(std::size_t b = j - deep_context; b < j - deep_context + deep_window; ++b){
-                        auto w_i = (a - (i - deep_context));
-                        auto w_j = (b - (j - deep_context));
-                        windows.back().at(w_i * deep_window + w_j) = image.pixels.at(a * image.height + b).r;
-                    }
+                if(stratified){
+                    std::size_t text = mask.text(x, y) ? 1 : 0;
+                    s_sampler.offer(text, g, [&]{ return sample_t(window, text); });
+                } else {
+                    sampler.offer(g, [&]{ return sample_t(window, mask.text(x, y) ? 1 : 0); });
                 }
             }
         }
     }
-}
 
-template<typename Images>
-Images large_pad(Images& d_images){
-    Images padded_images;
-
-    for(auto& image : d_images){
-        auto width = image.width + 2 * large_filter;
-        auto height = image.height + 2 * large_filter;
+    std::vector<sample_t> samples;
 
-        width = width % large_window > 0 ? (width / large_window + 1) * large_window : width;
-        height = height % large_window > 0 ? (height / large_window + 1) * large_window : height;
+    if(stratified){
+        samples = s_sampler.samples(g);
+    } else {
+        sampler.shuffle(g);
+        samples = std::move(sampler.samples);
+    }
 
-        padded_images.emplace_back(width, height);
+    for(auto& sample : samples){
+        windows.windows.push_back(sample.first);
+        labels.push_back(sample.second);
+    }
 
-        for(auto& pixel : padded_images.back().pixels){
-            pixel.r = pixel.g = pixel.b = 0;
-        }
+    return stratified ? s_sampler.seen() : sampler.seen;
+}
 
-        for(std::size_t row = 0; row < image.height; ++row){
-            for(std::size_t col = 0; col < image.width; ++col){
-                auto padded_row = row + large_filter;
-                auto padded_col = col + large_filter;
+template<typename Images>
+std::vector<planar_image> large_pad(const Images& d_images){
+    std::vector<planar_image> padded_images;
+    padded_images.reserve(d_images.size());
 
-                padded_images.back().pixels[padded_row * width + padded_col].r = image.pixels[row * image.width + col].r;
-                padded_images.back().pixels[padded_row * width + padded_col].g = image.pixels[row * image.width + col].g;
-                padded_images.back().pixels[padded_row * width + padded_col].b = image.pixels[row * image.width + col].b;
-            }
-        }
+    for(auto& image : d_images){
+        padded_images.push_back(make_planar_padded(image, large_filter, large_window));
     }
 
     return padded_images;
 }
 
-template<typename Images>
-void large_extract(std::vector<std::vector<float>>& patches, const Images& d_images){
+void large_extract(sample_batch<float>& patches, const std::vector<planar_image>& d_images){
+    constexpr const std::size_t patch_size = large_window * large_window * 3;
+
+    std::size_t n = 0;
     for(auto& image : d_images){
-        patches.reserve(patches.size() + (image.width / large_window) * (image.height / large_window));
-
-        for(std::size_t i = 0; i < image.height; i += large_window){
-            for(std::size_t j = 0; j < image.width; j += large_window){
-                patches.emplace_back(large_window * large_window * 3);
-
-                for(std::size_t a = i; a < i + large_window; ++a){
-                    for(std::size_t b = j; b < j + large_window; ++b){
-                        auto w_i = a - i;
-                        auto w_j = b - j;
-                        patches.back().at(w_i * large_window + w_j) = image.pixels.at(a * image.width + b).r;
-                        patches.back().at(w_i * large_window + w_j + 1) = image.pixels.at(a * image.width + b).g;
-                        patches.back().at(w_i * large_window + w_j + 2) = image.pixels.at(a * image.width + b).b;
-                    }
-                }
-            }
-        }
+        n += (image.width / large_window) * (image.height / large_window);
+    }
+
+    patches.data.reserve(patches.data.size() + n * patch_size);
+
+    for(auto& image : d_images){
+        extract_patches(image, large_window, patches.data);
     }
+
+    patches.make_views(patch_size);
 }
 
 template<typename Container>
@@ -126,7 +123,7 @@ std::size_t count_one(const Container& labels){
     return std::count(labels.begin(), labels.end(), 1);
 }
 
-int deep_wise(){
+int deep_wise(bool stratified = false){
     auto dataset = icdar::read_2013_dataset(
         "/home/wichtounet/datasets/icdar_2013_natural/train",
         "/home/wichtounet/datasets/icdar_2013_natural/test", 5, 1);
@@ -146,27 +143,25 @@ int deep_wise(){
 
     std::cout << deep_window << "x" << deep_window << " window dimension" << std::endl;
 
-    std::vector<std::vector<float>> training_windows;
+    window_dataset<decltype(dataset.training_images)> training_refs(dataset.training_images, deep_context);
     std::vector<std::size_t> training_labels;
 
-    std::vector<std::vector<float>> test_windows;
+    window_dataset<decltype(dataset.test_images)> test_refs(dataset.test_images, deep_context);
     std::vector<std::size_t> test_labels;
 
-    deep_extract(training_windows, training_labels, dataset.training_images, dataset.training_labels);
-
-    cpp::parallel_shuffle(training_windows.begin(), training_windows.end(), training_labels.begin(), training_labels.end(), g);
+    //The pixels are only gathered once the windows are selected
 
-    auto total_training = training_windows.size();
-    training_windows.resize(10000);
-    training_labels.resize(10000);
+    auto training_masks = make_label_masks(dataset.training_images, dataset.training_labels);
+    auto test_masks = make_label_masks(dataset.test_images, dataset.test_labels);
 
-    deep_extract(test_windows, test_labels, dataset.test_images, dataset.test_labels);
+    auto total_training = deep_sample(training_refs, training_labels, dataset.training_images, training_masks, 10000, stratified, g);
+    auto total_test = deep_sample(test_refs, test_labels, dataset.test_images, test_masks, 5000, stratified, g);
 
-    cpp::parallel_shuffle(test_windows.begin(), test_windows.end(), test_labels.begin(), test_labels.end(), g);
+    auto training_batch = training_refs.gather_all();
+    auto test_batch = test_refs.gather_all();
 
-    auto total_test = test_windows.size();
-    test_windows.resize(5000);
-    test_labels.resize(5000);
+    auto& training_windows = training_batch.samples;
+    auto& test_windows = test_batch.samples;
 
     //Normalize everything for Gaussian visible units
     cpp::normalize_each(training_windows);
@@ -235,8 +230,10 @@ void debug_padded(const Images& images){
         //buffer_image = cv::Scalar(255);
 
         for(std::size_t row = 0; row < image.height; ++row){
+            auto r = image.row(0, row);
+
             for(std::size_t col = 0; col < image.width; ++col){
-                buffer_image.at<uint8_t>(row, col) = 255 * image.pixels[row * image.width + col].r;
+                buffer_image.at<uint8_t>(row, col) = 255 * r[col];
             }
         }
 
@@ -262,72 +259,58 @@ void debug_patches(const Images& patches){
     }
 }
 
-template<typename DBN, typename Labels, typename Images, typename Patches, typename SFeatures, typename SLabels, typename RNG>
-void large_svm_extract(DBN& dbn, const Labels& labels, const Images& images, const Images& padded_images, const Patches& patches, SFeatures& svm_features, SLabels& svm_labels, std::size_t limit, RNG&& g){
+template<typename DBN, typename Images, typename Patches, typename SLabels, typename RNG>
+void large_svm_extract(DBN& dbn, const std::vector<label_mask>& masks, const Images& images, const std::vector<planar_image>& padded_images, const Patches& patches, feature_matrix& svm_features, SLabels& svm_labels, std::size_t limit, RNG&& g){
     std::cout << "Extraction for SVM..." << std::endl;
 
     //1. Get features from DBN
 
-    std::vector<std::vector<float>> rbm_features;
-    rbm_features.reserve(patches.size());
+    feature_matrix rbm_features;
+    rbm_features.resize(patches.size(), DBN::output_size());
 
-    for(auto& patch : patches){
-        rbm_features.emplace_back(DBN::output_size());
-        dbn.activation_probabilities(patch, rbm_features.back());
+    auto network = make_conv_network(dbn);
+
+    if(!network.empty()){
+        conv_extract(network, patches, rbm_features);
+    } else {
+        std::vector<float> features(DBN::output_size());
+
+        for(std::size_t i = 0; i < patches.size(); ++i){
+            dbn.activation_probabilities(patches[i], features);
+            std::copy(features.begin(), features.end(), rbm_features[i].begin());
+        }
     }
 
     std::cout << "Features extracted for " << patches.size() << " patches" << std::endl;
 
-    //2. Extract all locations
+    //2. Draw balanced text and background locations
 
-    std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>> locations;
-    locations.reserve(images.size() * 1000000);
+    std::vector<std::size_t> patch_offsets(images.size(), 0);
 
     std::size_t prev_patches = 0;
     for(std::size_t i_i = 0; i_i < images.size(); ++i_i){
-        auto& image = images[i_i];
         auto& padded_image = padded_images[i_i];
 
-        for(std::size_t y = 0; y < image.height; ++y){
-            for(std::size_t x = 0; x < image.width; ++x){
-                locations.emplace_back(i_i, x, y, prev_patches);
-            }
-        }
-
+        patch_offsets[i_i] = prev_patches;
         prev_patches += padded_image.height / large_window * padded_image.width / large_window;
     }
 
-    std::shuffle(locations.begin(), locations.end(), g);
+    auto locations = sample_balanced_locations(masks, limit, g);
 
-    std::cout << locations.size() << " locations extracted" << std::endl;
+    std::cout << locations.size() << " locations sampled" << std::endl;
 
     //3. Get features for SVM
 
-    svm_features.reserve(limit);
-    svm_labels.reserve(limit);
-
-    std::size_t count_0 = 0;
-    std::size_t count_1 = 0;
+    svm_features.reserve(locations.size(), large_features);
+    svm_labels.reserve(locations.size());
 
     for(auto& location : locations){
-        if(svm_features.size() == limit){
-            break;
-        }
-
-        auto i_i = std::get<0>(location);
-        auto x = std::get<1>(location);
-        auto y = std::get<2>(location);
+        auto i_i = location.image;
+        auto x = location.x;
+        auto y = location.y;
+        auto label = location.label;
 
         auto& padded_image = padded_images[i_i];
-        auto label = is_text(labels[i_i], x, y) ? 1 : 0;
-
-        if(label == 1 && (count_1 < 1.1 * count_0 || count_1 < 100)){
-            ++count_1;
-        } else if(label == 0 && (count_0 < 1.1 * count_1 || count_0 < 100)){
-            ++count_0;
-        } else {
-            continue;
-        }
 
         //Indexes in padded images
         auto global_y = y + large_filter;
@@ -341,70 +324,20 @@ void large_svm_extract(DBN& dbn, const Labels& labels, const Images& images, con
         auto local_y = y % large_window;
         auto local_x = x % large_window;
 
-        auto& patch = rbm_features[std::get<3>(location) + (patch_y * (padded_image.width / large_window) + patch_x)];
+        auto& patch = rbm_features[patch_offsets[i_i] + (patch_y * (padded_image.width / large_window) + patch_x)];
 
-        svm_features.emplace_back(large_features);
+        auto& features = svm_features.emplace_row();
 
         for(std::size_t i = 0; i < large_features; ++i){
-            svm_features.back()[i] = patch[local_y * large_window + local_x + i];
+            features[i] = patch[local_y * large_window + local_x + i];
         }
 
         svm_labels.push_back(label);
     }
 
-    svm_features.shrink_to_fit();
-    svm_labels.shrink_to_fit();
-
     std::cout << "... done" << std::endl;
 }
 
-void svm_scale(std::vector<std::vector<float>>& features){
-    std::cout << "Scale features" << std::endl;
-
-    //Scale each column
-
-    if(true){
-        //Version 1: Scale each feature in [0,1]
-
-        float a = 0.0;
-        float b = 1.0;
-
-        for(std::size_t i = 0; i < large_features; ++i){
-            float min = 0.0;
-            float max = 0.0;
-            for(auto& feature : features){
-                min = std::min(min, feature[i]);
-                max = std::max(max, feature[i]);
-            }
-
-            for(auto& feature : features){
-                feature[i] = a + ((b - a) * (feature[i] - min)) / (max - min);
-            }
-        }
-    } else {
-        //Version 1: Normalize each feature with zero-mean and unit variance
-
-        for(std::size_t i = 0; i < large_features; ++i){
-            float mean = 0.0;
-            for(auto& feature : features){
-                mean += feature[i];
-            }
-            mean /= features.size();
-            for(auto& feature : features){
-                feature[i] -= mean;
-            }
-            double stddev = 0.0;
-            for(auto& feature : features){
-                stddev += feature[i] * feature[i];
-            }
-            stddev = std::sqrt(stddev / features.size());
-            for(auto& feature : features){
-                feature[i] /= stddev;
-            }
-        }
-    }
-}
-
 int large_wise(){
     auto dataset = icdar::read_2013_dataset(
         "/home/wichtounet/datasets/icdar_2013_natural/train",
@@ -425,14 +358,20 @@ int large_wise(){
 
     std::cout << large_window << "x" << large_window << " window dimension\n\n";
 
+    auto training_masks = make_label_masks(dataset.training_images, dataset.training_labels);
+    auto test_masks = make_label_masks(dataset.test_images, dataset.test_labels);
+
     auto training_images_padded = large_pad(dataset.training_images);
     auto test_images_padded = large_pad(dataset.test_images);
 
-    std::vector<std::vector<float>> training_patches;
-    std::vector<std::vector<float>> test_patches;
+    sample_batch<float> training_patch_batch;
+    sample_batch<float> test_patch_batch;
 
-    large_extract(training_patches, training_images_padded);
-    large_extract(test_patches, test_images_padded);
+    large_extract(training_patch_batch, training_images_padded);
+    large_extract(test_patch_batch, test_images_padded);
+
+    auto& training_patches = training_patch_batch.samples;
+    auto& test_patches = test_patch_batch.samples;
 
     //Normalize everything for Gaussian visible units
     cpp::normalize_each(training_patches);
@@ -476,7 +415,8 @@ int large_wise(){
 
     svm::model model;
 
-    //TODO Maybe think of scaling features
+    //The scaling is fitted on the training features and reused for the test features
+    feature_scaler scaler(scaling::MIN_MAX);
 
     //Make it quiet
     //svm::make_quiet();
@@ -487,16 +427,20 @@ int large_wise(){
     {
 
         {
-            std::vector<std::vector<float>> features;
+            feature_matrix features;
             std::vector<uint8_t> labels;
 
-            large_svm_extract(*dbn, dataset.training_labels, dataset.training_images,
+            large_svm_extract(*dbn, training_masks, dataset.training_images,
                 training_images_padded, training_patches, features, labels, 50000, g);
 
             std::cout << features.size() << " training feature vectors extracted" << std::endl;
             std::cout << count_one(labels) / static_cast<double>(labels.size()) << "% text pixel" << std::endl;
 
-            svm_scale(features);
+            std::cout << "Scale features" << std::endl;
+
+            scaler.fit(features);
+            scaler.apply(features);
+            scaler.store("icdar_3d.scaler");
 
             std::cout << "Make SVM Problem" << std::endl;
 
@@ -530,15 +474,15 @@ int large_wise(){
         svm::problem test_problem;
 
         {
-            std::vector<std::vector<float>> features;
+            feature_matrix features;
             std::vector<uint8_t> labels;
 
-            large_svm_extract(*dbn, dataset.test_labels, dataset.test_images, test_images_padded, test_patches, features, labels, 50000, g);
+            large_svm_extract(*dbn, test_masks, dataset.test_images, test_images_padded, test_patches, features, labels, 50000, g);
 
             std::cout << features.size() << " test feature vectors extracted" << std::endl;
             std::cout << count_one(labels) / static_cast<double>(labels.size()) << "% text pixel" << std::endl;
 
-            svm_scale(features);
+            scaler.apply(features);
 
             test_problem = svm::make_problem(labels, features);
         }
@@ -5,7 +5,11 @@
 //  http://opensource.org/licenses/MIT)
 //=======================================================================
 
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
 
 #define DLL_PARALLEL
 #define DLL_SVM_SUPPORT
@@ -20,6 +24,11 @@
 
 #include "icdar/icdar_reader.hpp"
 
+#include "bit_map.hpp"
+#include "jpeg_loader.hpp"
+#include "parallel.hpp"
+#include "sliding_histogram.hpp"
+
 #include <opencv2/opencv.hpp>
 
 static constexpr const std::size_t window = 16;
@@ -37,11 +46,24 @@ constexpr uint8_t reduce_val(uint8_t val, uint8_t mul){
 }
 
 void reduce_image(cv::Mat& image, uint8_t mul){
-    for(std::size_t x = 0; x < static_cast<std::size_t>(image.cols); ++x){
-        for(std::size_t y = 0; y < static_cast<std::size_t>(image.rows); ++y){
-            image.at<cv::Vec3b>(cv::Point(x,y))[0] = reduce_val(image.at<cv::Vec3b>(cv::Point(x,y))[0], mul);
-            image.at<cv::Vec3b>(cv::Point(x,y))[1] = reduce_val(image.at<cv::Vec3b>(cv::Point(x,y))[1], mul);
-            image.at<cv::Vec3b>(cv::Point(x,y))[2] = reduce_val(image.at<cv::Vec3b>(cv::Point(x,y))[2], mul);
+    std::array<uint8_t, 256> lut;
+    for(std::size_t v = 0; v < 256; ++v){
+        lut[v] = reduce_val(v, mul);
+    }
+
+    //The three channels are reduced the same way, each row is a flat byte range
+    std::size_t bytes = image.cols * image.channels();
+    std::size_t rows = image.rows;
+
+    if(image.isContinuous()){
+        bytes *= rows;
+        rows = 1;
+    }
+
+    for(std::size_t y = 0; y < rows; ++y){
+        auto row = image.ptr<uint8_t>(y);
+        for(std::size_t i = 0; i < bytes; ++i){
+            row[i] = lut[row[i]];
         }
     }
 }
@@ -180,118 +202,136 @@ void quantize_image(cv::Mat& image, cv::Mat& quant_image){
     std::size_t width = image.cols;
     std::size_t height = image.rows;
 
-    for(std::size_t x = 0; x < width; ++x){
-        for(std::size_t y = 0; y < height; ++y){
-            uchar c1 = (image.at<cv::Vec3b>(cv::Point(x, y))[0] & 192) >> 2;
-            uchar c2 = (image.at<cv::Vec3b>(cv::Point(x, y))[1] & 192) >> 4;
-            uchar c3 = (image.at<cv::Vec3b>(cv::Point(x, y))[2] & 192) >> 6;
+    //Keep the two high bits of each channel, packed as 00112233
+    for(std::size_t y = 0; y < height; ++y){
+        auto in = image.ptr<uint8_t>(y);
+        auto out = quant_image.ptr<uint8_t>(y);
 
-            quant_image.at<uchar>(cv::Point(x, y)) = c1 | c2 | c3;
+        for(std::size_t x = 0; x < width; ++x){
+            out[x] = ((in[3 * x] & 192) >> 2) | ((in[3 * x + 1] & 192) >> 4) | (in[3 * x + 2] >> 6);
         }
     }
 }
 
-cv::Mat binarize(cv::Mat& source_image){
+bit_map binarize(cv::Mat& source_image){
     auto image = source_image.clone();
 
     std::size_t width = image.cols;
     std::size_t height = image.rows;
 
-    cv::Mat binary_map_image(image.rows, image.cols, CV_8U);
-    binary_map_image = cv::Scalar(0);
+    bit_map binary_map(width, height);
 
     cv::Mat quant_image(image.rows, image.cols, CV_8U);
     quant_image = cv::Scalar(0);
 
     quantize_image(image, quant_image);
 
-    std::vector<std::size_t> intensity_map(image.cols * image.rows, 0);
-
-    for(std::size_t x = 0; x * step_size + window < width; ++x){
-        for(std::size_t y = 0; y * step_size + window < height; ++y){
-            cv::Rect rect(x*step_size, y*step_size, window,window);
-            cv::Mat roi(quant_image, rect);
+    //Difference array of the intensity map, (width + 1) x (height + 1), row-major
+    std::size_t diff_stride = width + 1;
+    std::vector<int32_t> diff(diff_stride * (height + 1), 0);
 
-            auto peaks = count_peaks(roi, 0);
+    //The histogram of each window is updated incrementally from the previous one
+    sliding_windows(quant_image.ptr<uint8_t>(0), quant_image.step, width, height, window, step_size,
+        [&](std::size_t x, std::size_t y, const sliding_histogram& histogram){
+            auto peaks = histogram.peaks();
 
-            std::size_t value = peaks > min_peaks && peaks < max_peaks ? 3 : 0;
+            int32_t value = peaks > min_peaks && peaks < max_peaks ? 3 : 0;
 
             if(value > 0){
-                for(std::size_t xx = 0; xx < window; ++xx){
-                    for(std::size_t yy = 0; yy < window; ++yy){
-                        intensity_map[(xx + x * step_size) * height + yy + y * step_size] += value;
-                    }
-                }
+                //Add value to the window x window square in O(1)
+                auto left = x * step_size;
+                auto top = y * step_size;
+
+                diff[top * diff_stride + left] += value;
+                diff[top * diff_stride + left + window] -= value;
+                diff[(top + window) * diff_stride + left] -= value;
+                diff[(top + window) * diff_stride + left + window] += value;
             }
-        }
-    }
+        });
 
+    //Threshold of each column, the last columns use a lower (unsigned) threshold
+    std::vector<uint32_t> thresholds(width);
     for(std::size_t x = 0; x < width; ++x){
-        for(std::size_t y = 0; y < height; ++y){
-            if(x > image.cols - window){
-                if(intensity_map[x * height + y] < (binary_threshold - 5 * (width - x))){
-                    binary_map_image.at<uchar>(cv::Point(x,y)) = 0;
-                } else {
-                    binary_map_image.at<uchar>(cv::Point(x,y)) = 255;
-                }
-            } else {
-                if(intensity_map[x * image.rows + y] < binary_threshold){
-                    binary_map_image.at<uchar>(cv::Point(x,y)) = 0;
-                } else {
-                    binary_map_image.at<uchar>(cv::Point(x,y)) = 255;
-                }
-            }
-        }
+        std::size_t threshold = x > image.cols - window ? binary_threshold - 5 * (width - x) : binary_threshold;
+        thresholds[x] = static_cast<uint32_t>(std::min<std::size_t>(threshold, std::numeric_limits<uint32_t>::max()));
     }
 
-    return binary_map_image;
-}
+    //Prefix sums, column sums are carried from row to row
+    std::vector<int32_t> columns(width, 0);
+    std::vector<uint32_t> intensity(width);
+    std::vector<uint8_t> binary_row(width);
 
-cv::Mat combine(const std::vector<cv::Mat>& binary_maps){
-    if(binary_maps.size() == 1){
-        return binary_maps[0];
-    }
+    for(std::size_t y = 0; y < height; ++y){
+        auto diff_row = &diff[y * diff_stride];
 
-    std::size_t width = binary_maps[0].cols;
-    std::size_t height = binary_maps[0].rows;
+        for(std::size_t x = 0; x < width; ++x){
+            columns[x] += diff_row[x];
+        }
 
-    cv::Mat binary_map_image(height, width, CV_8U);
-    binary_map_image = cv::Scalar(0);
+        int32_t acc = 0;
+        for(std::size_t x = 0; x < width; ++x){
+            acc += columns[x];
+            intensity[x] = acc;
+        }
 
-    for(auto& binary_map : binary_maps){
         for(std::size_t x = 0; x < width; ++x){
-            for(std::size_t y = 0; y < height; ++y){
-                if(binary_map.at<uchar>(cv::Point(x,y)) == 255){
-                    binary_map_image.at<uchar>(cv::Point(x,y)) = 255;
-                }
-            }
+            binary_row[x] = intensity[x] < thresholds[x] ? 0 : 255;
         }
+
+        binary_map.pack_row(y, binary_row.data());
     }
 
-    return binary_map_image;
+    return binary_map;
 }
 
-void process_image(const std::string& source_path, bool bw = true, bool display = false){
-    std::cout << "Process image " << source_path << std::endl;
-    auto image = open_image(source_path);
-    auto dst_image = image.clone();
+bit_map combine(const std::vector<bit_map>& binary_maps){
+    auto binary_map = binary_maps[0];
+
+    for(std::size_t i = 1; i < binary_maps.size(); ++i){
+        binary_map |= binary_maps[i];
+    }
+
+    return binary_map;
+}
 
-    std::vector<cv::Mat> binary_maps;
+/*!
+ * \brief Compute the final binary map of an image (255 for text) as an 8-bit image
+ */
+cv::Mat compute_binary_map(cv::Mat& image){
+    std::vector<bit_map> binary_maps;
     binary_maps.push_back(binarize(image));
 
-    auto binary_map_image = combine(binary_maps);
+    auto binary_map = combine(binary_maps);
 
-    auto structure_elem = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(15, 15));
-    cv::morphologyEx(binary_map_image, binary_map_image, cv::MORPH_OPEN, structure_elem);
-    cv::morphologyEx(binary_map_image, binary_map_image, cv::MORPH_CLOSE, structure_elem);
+    //15x15 ellipse, the same element as cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(15, 15))
+    auto structure_elem = structuring_element::ellipse(7);
+    binary_map = morph_close(morph_open(binary_map, structure_elem), structure_elem);
+
+    cv::Mat binary_map_image(image.rows, image.cols, CV_8U);
+    for(std::size_t y = 0; y < binary_map.height; ++y){
+        binary_map.unpack_row(y, binary_map_image.ptr<uint8_t>(y));
+    }
+
+    return binary_map_image;
+}
+
+/*!
+ * \brief Draw the detection of the binary map on a copy of the image,
+ * either in bw mode (masked image and lines) or in contours mode.
+ */
+cv::Mat render_image(const cv::Mat& image, const cv::Mat& binary_map_image, bool bw, std::ostream& log){
+    auto dst_image = image.clone();
 
     if(bw){
-        for(std::size_t x = 0; x < static_cast<std::size_t>(image.cols); ++x){
-            for(std::size_t y = 0; y < static_cast<std::size_t>(image.rows); ++y){
-                if(binary_map_image.at<uchar>(cv::Point(x,y)) != 255){
-                    dst_image.at<cv::Vec3b>(cv::Point(x,y))[0] = 0;
-                    dst_image.at<cv::Vec3b>(cv::Point(x,y))[1] = 0;
-                    dst_image.at<cv::Vec3b>(cv::Point(x,y))[2] = 0;
+        for(std::size_t y = 0; y < static_cast<std::size_t>(image.rows); ++y){
+            auto map = binary_map_image.ptr<uint8_t>(y);
+            auto dst = dst_image.ptr<uint8_t>(y);
+
+            for(std::size_t x = 0; x < static_cast<std::size_t>(image.cols); ++x){
+                if(map[x] != 255){
+                    dst[3 * x] = 0;
+                    dst[3 * x + 1] = 0;
+                    dst[3 * x + 2] = 0;
                 }
             }
         }
@@ -349,9 +389,9 @@ void process_image(const std::string& source_path, bool bw = true, bool display
             }
 
             auto area = cv::contourArea(contours[i]);
-            std::cout << "contour " << i << " area = " << area << std::endl;
-            std::cout << "contour " << i << " rect area = " << rect_roi.area() << std::endl;
-            std::cout << "contour " << i << " area ratio = " << static_cast<double>(area) / rect_roi.area() << std::endl;
+            log << "contour " << i << " area = " << area << std::endl;
+            log << "contour " << i << " rect area = " << rect_roi.area() << std::endl;
+            log << "contour " << i << " area ratio = " << static_cast<double>(area) / rect_roi.area() << std::endl;
 
             cv::Scalar color(rng.uniform(0, 255), rng.uniform(0,255), rng.uniform(0,255) );
             //cv::drawContours(dst_image, contours, i, color, 2, 8, hierarchy, 0, cv::Point() );
@@ -361,12 +401,26 @@ void process_image(const std::string& source_path, bool bw = true, bool display
             ++c;
         }
 
-        std::cout << "   " << c << " contours found" << std::endl;
+        log << "   " << c << " contours found" << std::endl;
     }
 
-    auto dest_path = source_path;
-    dest_path.insert(dest_path.rfind('.'), bw ? ".zzz.map" : ".zzz.contours");
-    imwrite(dest_path.c_str(), dst_image);
+    return dst_image;
+}
+
+std::string dest_path(const std::string& source_path, bool bw){
+    auto path = source_path;
+    path.insert(path.rfind('.'), bw ? ".zzz.map" : ".zzz.contours");
+    return path;
+}
+
+void process_image(const std::string& source_path, bool bw = true, bool display = false){
+    std::cout << "Process image " << source_path << std::endl;
+    auto image = open_image(source_path);
+
+    auto binary_map_image = compute_binary_map(image);
+    auto dst_image = render_image(image, binary_map_image, bw, std::cout);
+
+    imwrite(dest_path(source_path, bw).c_str(), dst_image);
 
     if(display){
         cv::namedWindow("Source", cv::WINDOW_AUTOSIZE);
@@ -382,6 +436,103 @@ void process_image(const std::string& source_path, bool bw = true, bool display
     }
 }
 
+namespace {
+
+struct decoded_image {
+    std::string path;
+    cv::Mat image;
+};
+
+struct encoded_image {
+    std::string path;
+    std::vector<uchar> bw;
+    std::vector<uchar> contours;
+    std::string log;
+};
+
+} //end of anonymous namespace
+
+/*!
+ * \brief Process the bw and contours outputs of a batch of images.
+ *
+ * The images are decoded ahead by a reader thread, processed
+ * concurrently by the workers (the binary map being computed once for
+ * both outputs) and the encoded outputs are written by a writer thread.
+ * The log of each image is printed at once.
+ */
+void process_batch(const std::vector<std::string>& paths){
+    auto workers = std::max(std::size_t(1), default_threads() - 1);
+
+    bounded_queue<decoded_image> decoded(2 * workers);
+    bounded_queue<encoded_image> encoded(2 * workers);
+
+    std::thread reader([&]{
+        for(auto& path : paths){
+            decoded.push({path, open_image(path)});
+        }
+
+        decoded.close();
+    });
+
+    std::thread writer([&]{
+        encoded_image result;
+        while(encoded.pop(result)){
+            std::cout << result.log << std::flush;
+
+            for(bool bw : {true, false}){
+                auto& buffer = bw ? result.bw : result.contours;
+
+                //Nothing was encoded for an image that could not be decoded
+                if(buffer.empty()){
+                    continue;
+                }
+
+                auto path = dest_path(result.path, bw);
+
+                std::ofstream os(path, std::ofstream::binary);
+                os.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+                os.close();
+
+                if(!os){
+                    std::cerr << "Impossible to write " << path << std::endl;
+                }
+            }
+        }
+    });
+
+    auto extension = [](const std::string& path){
+        return path.substr(path.rfind('.'));
+    };
+
+    parallel_for_batches(workers, 1, [&](std::size_t, std::size_t, std::size_t){
+        decoded_image input;
+        while(decoded.pop(input)){
+            encoded_image result;
+            result.path = input.path;
+
+            std::ostringstream log;
+            log << "Process image " << input.path << std::endl;
+
+            if(input.image.data){
+                auto binary_map_image = compute_binary_map(input.image);
+
+                cv::imencode(extension(input.path), render_image(input.image, binary_map_image, true, log), result.bw);
+                cv::imencode(extension(input.path), render_image(input.image, binary_map_image, false, log), result.contours);
+            } else {
+                log << "   Impossible to read " << input.path << std::endl;
+            }
+
+            result.log = log.str();
+            encoded.push(std::move(result));
+        }
+    }, workers);
+
+    encoded.close();
+
+    reader.join();
+    writer.join();
+}
+
 int main(int argc, char* argv[]){
     bool test = true;
     if(argc > 1){
@@ -416,31 +567,52 @@ int main(int argc, char* argv[]){
             max = 328;
         }
 
+        std::vector<std::string> paths;
         for(std::size_t i = min; i <= max; ++i){
-            std::string source_path = prefix + std::to_string(i) + ".jpg";
-            process_image(source_path, true);
-            process_image(source_path, false);
+            paths.push_back(prefix + std::to_string(i) + ".jpg");
         }
+
+        process_batch(paths);
     }
 
     return 0;
 }
 
 cv::Mat open_image(const std::string& path){
-    auto source_image = cv::imread(path.c_str(), 1);
+    cv::Mat source_image;
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+
+    //Decode JPEG directly at a reduced scale, close to the final size
+    jpeg_image scaled;
+    if(is_jpeg_path(path) && read_jpeg_scaled(path, 1000, scaled)){
+        source_image = cv::Mat(scaled.height, scaled.width, CV_8UC3, scaled.data.data()).clone();
+        rows = scaled.full_height;
+        cols = scaled.full_width;
+    } else {
+        source_image = cv::imread(path.c_str(), 1);
+        rows = source_image.rows;
+        cols = source_image.cols;
+    }
 
     if (!source_image.data){
         return source_image;
     }
 
-    if(source_image.rows > 1000 || source_image.cols > 1000){
-        auto factor = 1000.0f / std::max(source_image.rows, source_image.cols);
+    if(rows > 1000 || cols > 1000){
+        //The final size is computed from the full size, the way cv::resize computes it from a factor,
+        //so that it does not depend on the DCT scale
+        auto factor = 1000.0f / std::max(rows, cols);
 
-        cv::Mat resized_image;
+        cv::Size size(cv::saturate_cast<int>(cols * static_cast<double>(factor)), cv::saturate_cast<int>(rows * static_cast<double>(factor)));
 
-        cv::resize(source_image, resized_image, cv::Size(), factor, factor, cv::INTER_AREA);
+        if(source_image.size() != size){
+            cv::Mat resized_image;
 
-        return resized_image;
+            cv::resize(source_image, resized_image, size, 0, 0, cv::INTER_AREA);
+
+            return resized_image;
+        }
     }
 
     return source_image;
@@ -0,0 +1,540 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file checkpoint.hpp
+ * \brief Periodic checkpoints of layer-wise pretraining and resume.
+ *
+ * The checkpoints are taken by a watcher at the end of the epochs of a
+ * normal train() or pretrain() call: the model is serialized in memory
+ * (with the store() of dll) together with the layer/epoch cursor, and a
+ * background thread writes it to disk, atomically. An uninterrupted
+ * checkpointed run is therefore the same as a run without checkpoints.
+ *
+ * The watchers are created by dll, so the state of the checkpoints of a
+ * model type is shared by all its watchers (as the log of the
+ * telemetry_watcher).
+ *
+ * The momentum increments and the random generator are private to the
+ * dll trainer and are not saved. A resumed layer starts a new train()
+ * call for its remaining epochs, and the inputs of the following layers
+ * are computed with the flat inference networks (or with the layers
+ * themselves for the stacks with pooling), so a resumed run is not
+ * bit-identical to an uninterrupted one.
+ */
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "dll/watcher.hpp"
+
+#include "dbn_convert.hpp"
+#include "parallel.hpp"
+#include "sample_view.hpp"
+
+/*!
+ * \brief When to checkpoint, every epochs epochs and/or every seconds
+ * seconds (checked at the end of an epoch). 0 disables a criterion.
+ */
+struct checkpoint_policy {
+    std::size_t epochs = 5;
+    std::size_t seconds = 0;
+
+    /*!
+     * \brief Read the policy from the command line:
+     * --checkpoint-epochs N, --checkpoint-minutes N
+     */
+    static checkpoint_policy parse(int argc, char* argv[]){
+        checkpoint_policy policy;
+
+        for(int i = 1; i + 1 < argc; ++i){
+            std::string option(argv[i]);
+
+            if(option == "--checkpoint-epochs"){
+                policy.epochs = std::stoul(argv[++i]);
+            } else if(option == "--checkpoint-minutes"){
+                policy.seconds = 60 * std::stoul(argv[++i]);
+            }
+        }
+
+        return policy;
+    }
+};
+
+/*!
+ * \brief Position of the pretraining: epoch epochs of layer layer are done
+ */
+struct checkpoint_cursor {
+    uint32_t layer = 0;
+    uint32_t epoch = 0;
+};
+
+namespace checkpoint_detail {
+
+constexpr const char magic[8] = {'D', 'B', 'N', 'C', 'K', 'P', 'T', '1'};
+constexpr const uint32_t version = 1;
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t layer;
+    uint32_t epoch;
+    uint32_t max_epochs;
+    uint64_t size; ///< Bytes of the stored model following the header
+};
+
+static_assert(sizeof(header) == 32, "The checkpoint header must be packed");
+
+struct checkpoint {
+    header h;
+    std::string model;
+};
+
+/*!
+ * \brief Write the checkpoints on a background thread.
+ *
+ * At most one checkpoint waits while another one is written, the
+ * training only blocks if it produces checkpoints faster than that.
+ */
+struct checkpoint_writer {
+    explicit checkpoint_writer(std::string path) : path(std::move(path)), queue(1) {
+        thread = std::thread([this]{
+            checkpoint c;
+            while(queue.pop(c)){
+                write(c);
+            }
+        });
+    }
+
+    ~checkpoint_writer(){
+        queue.close();
+        thread.join();
+    }
+
+    template<typename Model>
+    void submit(Model& model, checkpoint_cursor cursor, std::size_t max_epochs){
+        checkpoint c;
+
+        std::ostringstream os;
+        model.store(os);
+        c.model = os.str();
+
+        std::memcpy(c.h.magic, magic, sizeof(magic));
+        c.h.version = version;
+        c.h.layer = cursor.layer;
+        c.h.epoch = cursor.epoch;
+        c.h.max_epochs = max_epochs;
+        c.h.size = c.model.size();
+
+        queue.push(std::move(c));
+    }
+
+private:
+    void write(const checkpoint& c){
+        auto tmp = path + ".tmp";
+
+        {
+            std::ofstream os(tmp, std::ofstream::binary | std::ofstream::trunc);
+            os.write(reinterpret_cast<const char*>(&c.h), sizeof(c.h));
+            os.write(c.model.data(), c.model.size());
+
+            if(!os){
+                std::cerr << "Impossible to write the checkpoint " << tmp << std::endl;
+                return;
+            }
+        }
+
+        if(std::rename(tmp.c_str(), path.c_str()) != 0){
+            std::cerr << "Impossible to rename the checkpoint " << tmp << std::endl;
+        }
+    }
+
+    std::string path;
+    bounded_queue<checkpoint> queue;
+    std::thread thread;
+};
+
+/*!
+ * \brief Checkpoint state of the training of a model of type Model.
+ */
+template<typename Model>
+struct session {
+    const Model* model = nullptr;
+    std::unique_ptr<checkpoint_writer> writer;
+    checkpoint_policy policy;
+    std::size_t max_epochs = 0;
+    std::size_t layer = 0;  ///< The layer being trained
+    std::size_t offset = 0; ///< Epochs of the layer done before the current train() call
+    std::size_t since = 0;  ///< Epochs since the last checkpoint
+    std::chrono::steady_clock::time_point last;
+
+    static session& instance(){
+        static session s;
+        return s;
+    }
+
+    void start(const Model& model, const std::string& path, checkpoint_policy policy, std::size_t max_epochs){
+        this->model = &model;
+        this->writer = std::make_unique<checkpoint_writer>(path);
+        this->policy = policy;
+        this->max_epochs = max_epochs;
+        layer = 0;
+        offset = 0;
+        since = 0;
+        last = std::chrono::steady_clock::now();
+    }
+
+    //The pending checkpoint is written before the writer is destroyed
+    void stop(){
+        writer.reset();
+        model = nullptr;
+    }
+
+    void epoch_end(std::size_t epoch){
+        if(!model){
+            return;
+        }
+
+        auto done = offset + epoch + 1;
+        ++since;
+
+        if(done < max_epochs && due()){
+            save(layer, done);
+        }
+    }
+
+    void layer_end(){
+        if(!model){
+            return;
+        }
+
+        save(layer + 1, 0);
+
+        ++layer;
+        offset = 0;
+    }
+
+    /*!
+     * \brief Stop the session when the training ends, even by an exception,
+     * so that the last checkpoint is on disk
+     */
+    struct scope {
+        ~scope(){
+            instance().stop();
+        }
+    };
+
+private:
+    bool due() const {
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - last).count();
+        return (policy.epochs && since >= policy.epochs) || (policy.seconds && static_cast<std::size_t>(elapsed) >= policy.seconds);
+    }
+
+    void save(std::size_t layer, std::size_t epoch){
+        writer->submit(*model, {static_cast<uint32_t>(layer), static_cast<uint32_t>(epoch)}, max_epochs);
+        since = 0;
+        last = std::chrono::steady_clock::now();
+    }
+};
+
+} //end of namespace checkpoint_detail
+
+/*!
+ * \brief RBM watcher taking the checkpoints of checkpointed_train, on
+ * top of the watcher Watcher of the training (the default one unless
+ * specified).
+ */
+template<typename RBM, typename Watcher = dll::default_rbm_watcher<RBM>>
+struct checkpoint_rbm_watcher : Watcher {
+    using base_type = Watcher;
+
+    void epoch_end(std::size_t epoch, double error, double free_energy, const RBM& rbm){
+        base_type::epoch_end(epoch, error, free_energy, rbm);
+
+        checkpoint_detail::session<RBM>::instance().epoch_end(epoch);
+    }
+
+    void training_end(const RBM& rbm){
+        checkpoint_detail::session<RBM>::instance().layer_end();
+
+        base_type::training_end(rbm);
+    }
+};
+
+/*!
+ * \brief DBN watcher taking the checkpoints of checkpointed_pretrain.
+ *
+ * It also replaces the watchers of the layers, which are counted as
+ * their training ends.
+ */
+template<typename DBN>
+struct checkpoint_dbn_watcher : dll::default_dbn_watcher<DBN> {
+    static constexpr const bool replace_sub = true;
+
+    template<typename RBM>
+    void training_begin(const RBM& /*rbm*/){}
+
+    template<typename RBM>
+    void epoch_end(std::size_t epoch, double error, double free_energy, const RBM& /*rbm*/){
+        std::printf("epoch %zu - Reconstruction error: %.5f - Free energy: %.3f\n", epoch, error, free_energy);
+
+        checkpoint_detail::session<DBN>::instance().epoch_end(epoch);
+    }
+
+    template<typename RBM, typename Context>
+    void batch_end(const RBM& /*rbm*/, const Context& /*context*/, std::size_t /*batch*/, std::size_t /*batches*/){}
+
+    template<typename RBM>
+    void training_end(const RBM& /*rbm*/){
+        checkpoint_detail::session<DBN>::instance().layer_end();
+    }
+};
+
+namespace checkpoint_detail {
+
+/*!
+ * \brief Compute the activation probabilities of the layer I for all
+ * the input samples, with the flat network of the model.
+ */
+template<std::size_t I, typename Input>
+sample_batch<float> propagate(const dense_network& network, const Input& input){
+    auto& layer = network.layers[I];
+
+    sample_batch<float> output;
+    output.resize(input.size(), layer.outputs);
+
+    parallel_for_batches(input.size(), 256, [&](std::size_t first, std::size_t last, std::size_t /*thread*/){
+        std::vector<float> batch;
+        gather_batch(input, first, last, layer.inputs, batch);
+        dense_layer_forward(layer, batch.data(), last - first, output.data.data() + first * layer.outputs);
+    });
+
+    return output;
+}
+
+template<std::size_t I, typename Input>
+sample_batch<float> propagate(const conv_network& network, const Input& input){
+    auto& layer = network.layers[I];
+
+    sample_batch<float> output;
+    output.resize(input.size(), layer.outputs());
+
+    parallel_for_batches(input.size(), 16, [&](std::size_t first, std::size_t last, std::size_t /*thread*/){
+        std::vector<float> sample;
+
+        for(std::size_t i = first; i < last; ++i){
+            gather_batch(input, i, i + 1, layer.inputs(), sample);
+            conv_layer_forward(layer, sample.data(), output.data.data() + i * layer.outputs());
+        }
+    });
+
+    return output;
+}
+
+/*!
+ * \brief Compute the activation probabilities of the layer I for all
+ * the input samples with the layer itself, for the stacks that have no
+ * flat network (max-pooling layers for instance).
+ */
+template<std::size_t I, typename DBN, typename Input>
+sample_batch<float> propagate_layer(const DBN& dbn, const Input& input){
+    auto& layer = convert_detail::get_layer<I>(dbn, 0);
+
+    sample_batch<float> output;
+    output.resize(input.size(), layer.output_size());
+
+    std::vector<float> features(layer.output_size());
+
+    for(std::size_t i = 0; i < input.size(); ++i){
+        layer.activation_probabilities(input[i], features);
+        std::copy(features.begin(), features.end(), output.samples[i].begin());
+    }
+
+    return output;
+}
+
+/*!
+ * \brief Compute the inputs of the layer I + 1, with the flat network of
+ * the DBN if there is one
+ */
+template<std::size_t I, typename DBN, typename Input>
+sample_batch<float> propagate(const DBN& dbn, const Input& input){
+    auto dense = make_dense_network(dbn);
+    if(!dense.empty()){
+        return propagate<I>(dense, input);
+    }
+
+    auto conv = make_conv_network(dbn);
+    if(!conv.empty()){
+        return propagate<I>(conv, input);
+    }
+
+    return propagate_layer<I>(dbn, input);
+}
+
+/*!
+ * \brief Continue the pretraining of the layers from the cursor, each
+ * remaining layer being trained with a single train() call.
+ */
+template<typename DBN, typename Input>
+void resume_layers(DBN& /*dbn*/, const Input& /*input*/, checkpoint_cursor /*cursor*/, std::integral_constant<std::size_t, DBN::layers>){}
+
+template<typename DBN, typename Input, std::size_t I, std::enable_if_t<(I < DBN::layers), int> = 0>
+void resume_layers(DBN& dbn, const Input& input, checkpoint_cursor cursor, std::integral_constant<std::size_t, I>){
+    if(I >= cursor.layer){
+        auto& s = session<DBN>::instance();
+
+        s.layer = I;
+        s.offset = I == cursor.layer ? cursor.epoch : 0;
+
+        std::cout << "Pretrain layer " << I << " from epoch " << s.offset << std::endl;
+
+        convert_detail::get_layer<I>(dbn, 0).template train<true, checkpoint_dbn_watcher<DBN>>(input, s.max_epochs - s.offset);
+    }
+
+    if(I + 1 < DBN::layers){
+        auto next = propagate<I>(dbn, input);
+
+        resume_layers(dbn, next.samples, cursor, std::integral_constant<std::size_t, I + 1>());
+    }
+}
+
+} //end of namespace checkpoint_detail
+
+/*!
+ * \brief Read the cursor and the model of a checkpoint file.
+ *
+ * The checkpoint is rejected, and the model left untouched, if it was
+ * taken for a different number of epochs per layer.
+ */
+template<typename Model>
+bool load_checkpoint(const std::string& path, Model& model, checkpoint_cursor& cursor, std::size_t max_epochs){
+    std::ifstream is(path, std::ifstream::binary | std::ifstream::ate);
+
+    if(!is){
+        return false;
+    }
+
+    auto file_size = static_cast<std::size_t>(is.tellg());
+    is.seekg(0);
+
+    checkpoint_detail::header h;
+    if(!is.read(reinterpret_cast<char*>(&h), sizeof(h))){
+        return false;
+    }
+
+    if(std::memcmp(h.magic, checkpoint_detail::magic, sizeof(h.magic)) != 0 || h.version != checkpoint_detail::version){
+        std::cerr << path << " is not a valid checkpoint" << std::endl;
+        return false;
+    }
+
+    if(h.size > file_size - sizeof(h)){
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    if(h.max_epochs != max_epochs || h.epoch >= max_epochs){
+        std::cerr << path << " was taken for " << h.max_epochs << " epochs per layer, not " << max_epochs << std::endl;
+        return false;
+    }
+
+    std::string blob(h.size, '\0');
+    if(!is.read(&blob[0], blob.size())){
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    std::istringstream model_stream(blob);
+    model.load(model_stream);
+
+    cursor.layer = h.layer;
+    cursor.epoch = h.epoch;
+
+    return true;
+}
+
+/*!
+ * \brief Pretrain a DBN layer-wise for max_epochs epochs per layer, with
+ * periodic checkpoints in path.
+ *
+ * The DBN must use the checkpoint_dbn_watcher, which takes the
+ * checkpoints during its pretrain(). With resume, the DBN and the
+ * position are restored from path (if it exists) and the pretraining
+ * continues from there.
+ */
+template<typename DBN, typename Samples>
+void checkpointed_pretrain(DBN& dbn, const Samples& samples, std::size_t max_epochs, const std::string& path, checkpoint_policy policy = {}, bool resume = false){
+    checkpoint_cursor cursor;
+
+    if(resume){
+        if(load_checkpoint(path, dbn, cursor, max_epochs)){
+            std::cout << "Resume from " << path << " (layer " << cursor.layer << ", epoch " << cursor.epoch << ")" << std::endl;
+        } else {
+            std::cout << "No checkpoint to resume from, start from scratch" << std::endl;
+        }
+    }
+
+    auto& s = checkpoint_detail::session<DBN>::instance();
+    s.start(dbn, path, policy, max_epochs);
+
+    typename checkpoint_detail::session<DBN>::scope scope;
+
+    if(!cursor.layer && !cursor.epoch){
+        dbn.pretrain(samples, max_epochs);
+    } else if(cursor.layer < DBN::layers){
+        checkpoint_detail::resume_layers(dbn, samples, cursor, std::integral_constant<std::size_t, 0>());
+    }
+}
+
+/*!
+ * \brief Train a single RBM for max_epochs epochs with periodic
+ * checkpoints in path, resuming from it if asked.
+ *
+ * The RBM is trained with the checkpoint_rbm_watcher on top of
+ * Watcher<RBM> in place of its own watcher.
+ */
+template<template<typename...> class Watcher = dll::default_rbm_watcher, typename RBM, typename Samples>
+void checkpointed_train(RBM& rbm, const Samples& samples, std::size_t max_epochs, const std::string& path, checkpoint_policy policy = {}, bool resume = false){
+    checkpoint_cursor cursor;
+
+    if(resume){
+        if(load_checkpoint(path, rbm, cursor, max_epochs)){
+            std::cout << "Resume from " << path << " (epoch " << cursor.epoch << ")" << std::endl;
+        } else {
+            std::cout << "No checkpoint to resume from, start from scratch" << std::endl;
+        }
+    }
+
+    //The training is already complete
+    if(cursor.layer > 0){
+        return;
+    }
+
+    auto& s = checkpoint_detail::session<RBM>::instance();
+    s.start(rbm, path, policy, max_epochs);
+    s.offset = cursor.epoch;
+
+    typename checkpoint_detail::session<RBM>::scope scope;
+
+    rbm.template train<true, checkpoint_rbm_watcher<RBM, Watcher<RBM>>>(samples, max_epochs - cursor.epoch);
+}
+
+#endif
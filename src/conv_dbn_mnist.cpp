@@ -15,27 +15,18 @@
 #include "dll/conv_rbm_mp.hpp"
 #include "dll/dbn.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
-
-template<typename DBN, typename Dataset, typename P>
-void test_all(DBN& dbn, Dataset& dataset, P&& predictor){
-    std::cout << "Start testing" << std::endl;
-
-    std::cout << "Training Set" << std::endl;
-    auto error_rate = dll::test_set(dbn, dataset.training_images, dataset.training_labels, predictor);
-    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
-
-    std::cout << "Test Set" << std::endl;
-    error_rate =  dll::test_set(dbn, dataset.test_images, dataset.test_labels, predictor);
-    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
-}
+#include "checkpoint.hpp"
+#include "evaluation.hpp"
+#include "mnist_cache.hpp"
+#include "model_file.hpp"
 
 int main(int argc, char* argv[]){
     auto load = false;
     auto svm = false;
     auto mp = false;
     auto shuffle = false;
+    auto checkpoint = false;
+    auto resume = false;
 
     for(int i = 1; i < argc; ++i){
         std::string command(argv[i]);
@@ -48,10 +39,15 @@ int main(int argc, char* argv[]){
             mp = true;
         } else if(command == "shuffle"){
             shuffle = true;
+        } else if(command == "checkpoint"){
+            checkpoint = true;
+        } else if(command == "resume"){
+            checkpoint = true;
+            resume = true;
         }
     }
 
-    auto dataset = mnist::read_dataset_direct<std::vector, etl::fast_dyn_matrix<double, 1, 28, 28>>(1000);
+    auto dataset = read_cached_dataset_direct<std::vector, etl::fast_dyn_matrix<double, 1, 28, 28>>(1000, cache_mode::BINARIZE);
 
     if(dataset.training_images.empty() || dataset.training_labels.empty()){
         return 1;
@@ -69,127 +65,145 @@ int main(int argc, char* argv[]){
     //dataset.training_images.resize(10000);
     //dataset.training_labels.resize(10000);
 
-    mnist::binarize_dataset(dataset);
+    auto pretrain = [&](auto& dbn, std::size_t epochs){
+        std::cout << "Start pretraining" << std::endl;
 
-    if(mp){
-        typedef dll::dbn_desc<
-            dll::dbn_layers<
-            dll::conv_rbm_mp_desc_square<1, 28, 40, 18, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
-            dll::conv_rbm_mp_desc_square<40, 9, 40, 6, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
-                >, dll::svm_concatenate>::dbn_t dbn_t;
-
-        auto dbn = std::make_unique<dbn_t>();
+        if(checkpoint){
+            checkpointed_pretrain(dbn, dataset.training_images, epochs, mp ? "dbn_mp.ckpt" : "dbn.ckpt", checkpoint_policy::parse(argc, argv), resume);
+        } else {
+            dbn.pretrain(dataset.training_images, epochs);
+        }
+    };
 
-        dbn->layer_get<0>().pbias = 0.05;
-        dbn->layer_get<0>().pbias_lambda = 50;
+    auto setup = [&](auto& dbn){
+        dbn->template layer_get<0>().pbias = 0.05;
+        dbn->template layer_get<0>().pbias_lambda = 50;
 
-        dbn->layer_get<1>().pbias = 0.05;
-        dbn->layer_get<1>().pbias_lambda = 100;
+        dbn->template layer_get<1>().pbias = 0.05;
+        dbn->template layer_get<1>().pbias_lambda = 100;
 
         dbn->display();
 
-        std::cout << "RBM1: Input: " << dbn->layer_get<0>().input_size() << std::endl;
-        std::cout << "RBM1: Output: " << dbn->layer_get<0>().output_size() << std::endl;
+        std::cout << "RBM1: Input: " << dbn->template layer_get<0>().input_size() << std::endl;
+        std::cout << "RBM1: Output: " << dbn->template layer_get<0>().output_size() << std::endl;
 
-        std::cout << "RBM2: Input: " << dbn->layer_get<1>().input_size() << std::endl;
-        std::cout << "RBM2: Output: " << dbn->layer_get<1>().output_size() << std::endl;
+        std::cout << "RBM2: Input: " << dbn->template layer_get<1>().input_size() << std::endl;
+        std::cout << "RBM2: Output: " << dbn->template layer_get<1>().output_size() << std::endl;
+    };
 
-        if(svm){
-            if(load){
-                std::cout << "Load from file" << std::endl;
+    auto run_svm = [&](auto& dbn){
+        if(load){
+            std::cout << "Load from file" << std::endl;
 
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
-            } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 50);
-            }
-
-            auto parameters = dll::default_svm_parameters();
-            //parameters.C = 2.09091;
-            //parameters.gamma = 0.272727;
-
-            if(!dbn->svm_train(dataset.training_images, dataset.training_labels, parameters)){
-                std::cout << "SVM training failed" << std::endl;
-            }
-
-            std::ofstream os("dbn.dat", std::ofstream::binary);
-            dbn->store(os);
-
-            test_all(dbn, dataset, dll::svm_predictor());
+            std::ifstream is("dbn.dat", std::ifstream::binary);
+            dbn->load(is);
         } else {
-            if(load){
-                std::cout << "Load from file" << std::endl;
-
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
-            } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 5);
-
-                std::ofstream os("dbn.dat", std::ofstream::binary);
-                dbn->store(os);
-            }
+            pretrain(*dbn, 50);
         }
-    } else {
-        typedef dll::dbn_desc<
-            dll::dbn_layers<
-            dll::conv_rbm_desc_square<1, 28, 40, 17, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
-            dll::conv_rbm_desc_square<40, 17, 40, 12, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
-                >>::dbn_t dbn_t;
-
-        auto dbn = std::make_unique<dbn_t>();
 
-        dbn->layer_get<0>().pbias = 0.05;
-        dbn->layer_get<0>().pbias_lambda = 50;
+        auto parameters = dll::default_svm_parameters();
+        //parameters.C = 2.09091;
+        //parameters.gamma = 0.272727;
 
-        dbn->layer_get<1>().pbias = 0.05;
-        dbn->layer_get<1>().pbias_lambda = 100;
-
-        dbn->display();
+        if(!dbn->svm_train(dataset.training_images, dataset.training_labels, parameters)){
+            std::cout << "SVM training failed" << std::endl;
+        }
 
-        std::cout << "RBM1: Input: " << dbn->layer_get<0>().input_size() << std::endl;
-        std::cout << "RBM1: Output: " << dbn->layer_get<0>().output_size() << std::endl;
+        std::ofstream os("dbn.dat", std::ofstream::binary);
+        dbn->store(os);
 
-        std::cout << "RBM2: Input: " << dbn->layer_get<1>().input_size() << std::endl;
-        std::cout << "RBM2: Output: " << dbn->layer_get<1>().output_size() << std::endl;
+        test_all(dbn, dataset, dll::svm_predictor());
+    };
 
-        if(svm){
-            if(load){
-                std::cout << "Load from file" << std::endl;
+    if(mp){
+        auto run = [&](auto& dbn){
+            setup(dbn);
 
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
+            if(svm){
+                run_svm(dbn);
             } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 50);
-            }
+                if(load){
+                    std::cout << "Load from file" << std::endl;
 
-            auto parameters = dll::default_svm_parameters();
-            //parameters.C = 2.09091;
-            //parameters.gamma = 0.272727;
+                    std::ifstream is("dbn.dat", std::ifstream::binary);
+                    dbn->load(is);
+                } else {
+                    pretrain(*dbn, 5);
 
-            if(!dbn->svm_train(dataset.training_images, dataset.training_labels, parameters)){
-                std::cout << "SVM training failed" << std::endl;
+                    std::ofstream os("dbn.dat", std::ofstream::binary);
+                    dbn->store(os);
+                }
             }
+        };
 
-            std::ofstream os("dbn.dat", std::ofstream::binary);
-            dbn->store(os);
+        if(!checkpoint){
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::conv_rbm_mp_desc_square<1, 28, 40, 18, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+                dll::conv_rbm_mp_desc_square<40, 9, 40, 6, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                    >, dll::svm_concatenate>::dbn_t dbn_t;
 
-            test_all(dbn, dataset, dll::svm_predictor());
+            auto dbn = std::make_unique<dbn_t>();
+            run(dbn);
         } else {
-            if(load){
-                std::cout << "Load from file" << std::endl;
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::conv_rbm_mp_desc_square<1, 28, 40, 18, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+                dll::conv_rbm_mp_desc_square<40, 9, 40, 6, 2, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                    >, dll::svm_concatenate, dll::watcher<checkpoint_dbn_watcher>>::dbn_t dbn_t;
+
+            auto dbn = std::make_unique<dbn_t>();
+            run(dbn);
+        }
+    } else {
+        auto run = [&](auto& dbn){
+            setup(dbn);
 
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
+            if(svm){
+                run_svm(dbn);
             } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 5);
-
-                std::ofstream os("dbn.dat", std::ofstream::binary);
-                dbn->store(os);
+                if(load){
+                    std::cout << "Load from file" << std::endl;
+
+                    if(std::ifstream("dbn.model")){
+                        if(!load_model_file("dbn.model", *dbn)){
+                            return 1;
+                        }
+                    } else {
+                        std::ifstream is("dbn.dat", std::ifstream::binary);
+                        dbn->load(is);
+                    }
+                } else {
+                    pretrain(*dbn, 5);
+
+                    std::ofstream os("dbn.dat", std::ofstream::binary);
+                    dbn->store(os);
+
+                    save_model_file(*dbn, "dbn.model");
+                }
             }
+
+            return 0;
+        };
+
+        if(!checkpoint){
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::conv_rbm_desc_square<1, 28, 40, 17, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+                dll::conv_rbm_desc_square<40, 17, 40, 12, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                    >>::dbn_t dbn_t;
+
+            auto dbn = std::make_unique<dbn_t>();
+            return run(dbn);
+        } else {
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::conv_rbm_desc_square<1, 28, 40, 17, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t,
+                dll::conv_rbm_desc_square<40, 17, 40, 12, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>, dll::sparsity<dll::sparsity_method::LEE>>::layer_t
+                    >, dll::watcher<checkpoint_dbn_watcher>>::dbn_t dbn_t;
+
+            auto dbn = std::make_unique<dbn_t>();
+            return run(dbn);
         }
     }
 
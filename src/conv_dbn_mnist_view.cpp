@@ -12,33 +12,18 @@
 #include "dll/conv_dbn.hpp"
 #include "dll/ocv_visualizer.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
+#include "async_visualizer.hpp"
+#include "mnist_cache.hpp"
 
-int main(int argc, char* argv[]){
-    auto load = false;
-
-    for(int i = 1; i < argc; ++i){
-        std::string command(argv[i]);
-
-        if(command == "load"){
-            load = true;
-        }
-    }
-
-    auto dataset = mnist::read_dataset<std::vector, std::vector, double>(5000);
-
-    if(dataset.training_images.empty() || dataset.training_labels.empty()){
-        return 1;
-    }
-
-    mnist::binarize_dataset(dataset);
+namespace {
 
+template<template<typename...> class Watcher, typename Dataset>
+void train(const Dataset& dataset, bool load){
     typedef dll::conv_dbn_desc<
         dll::dbn_layers<
             dll::conv_rbm_desc<28, 1, 17, 40, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>>::rbm_t,
             dll::conv_rbm_desc<17, 40, 12, 40, dll::momentum, dll::batch_size<50>, dll::weight_decay<dll::decay_type::L2>>::rbm_t
-        >, dll::watcher<dll::opencv_dbn_visualizer>>::dbn_t dbn_t;
+        >, dll::watcher<Watcher>>::dbn_t dbn_t;
 
     auto dbn = std::make_unique<dbn_t>();
 
@@ -56,6 +41,35 @@ int main(int argc, char* argv[]){
         std::ofstream os("dbn.dat", std::ofstream::binary);
         dbn->store(os);
     }
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    auto load = false;
+    auto async = false;
+
+    for(int i = 1; i < argc; ++i){
+        std::string command(argv[i]);
+
+        if(command == "load"){
+            load = true;
+        } else if(command == "async"){
+            async = true;
+        }
+    }
+
+    auto dataset = read_cached_dataset<double>(5000, cache_mode::BINARIZE);
+
+    if(dataset.training_images.empty() || dataset.training_labels.empty()){
+        return 1;
+    }
+
+    if(async){
+        train<async_dbn_visualizer>(dataset, load);
+    } else {
+        train<dll::opencv_dbn_visualizer>(dataset, load);
+    }
 
     return 0;
 }
@@ -0,0 +1,161 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file conv_network.hpp
+ * \brief Flat, inference-only representation of a stack of convolutional RBMs.
+ */
+
+#ifndef CONV_NETWORK_HPP
+#define CONV_NETWORK_HPP
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "dense_network.hpp"
+#include "parallel.hpp"
+
+/*!
+ * \brief One convolutional layer: NC input channels of NV x NV, K output
+ * maps of NH x NH, computed with NW x NW filters (NW = NV - NH + 1).
+ * The layer does not own its weights. As for dense_layer, the visible
+ * units are only kept to restore the RBM.
+ */
+struct conv_layer {
+    std::size_t nc;
+    std::size_t nv;
+    std::size_t k;
+    std::size_t nh;
+    dense_activation activation;
+    const float* weights;         ///< nc x k x nw x nw
+    const float* biases;          ///< k
+    dense_activation visible;     ///< Activation of the visible units
+    const float* visible_biases;  ///< nc
+
+    std::size_t nw() const {
+        return nv - nh + 1;
+    }
+
+    std::size_t inputs() const {
+        return nc * nv * nv;
+    }
+
+    std::size_t outputs() const {
+        return k * nh * nh;
+    }
+};
+
+/*!
+ * \brief A stack of convolutional layers with the storage of their weights
+ */
+struct conv_network {
+    std::vector<conv_layer> layers;
+    std::shared_ptr<const void> storage; ///< Keeps the weights alive
+
+    bool empty() const {
+        return layers.empty();
+    }
+
+    std::size_t input_size() const {
+        return layers.front().inputs();
+    }
+
+    std::size_t output_size() const {
+        return layers.back().outputs();
+    }
+
+    std::size_t max_width() const {
+        std::size_t width = 0;
+        for(auto& layer : layers){
+            width = std::max(width, std::max(layer.inputs(), layer.outputs()));
+        }
+        return width;
+    }
+};
+
+/*!
+ * \brief Compute the activation probabilities of a convolutional layer for one sample.
+ *
+ * Each hidden map is the sum over the channels of the valid
+ * cross-correlation of the input with the filter. The innermost loop
+ * runs over a contiguous hidden row, which the compiler vectorizes.
+ */
+inline void conv_layer_forward(const conv_layer& layer, const float* input, float* output){
+    auto nw = layer.nw();
+    auto nv = layer.nv;
+    auto nh = layer.nh;
+
+    for(std::size_t k = 0; k < layer.k; ++k){
+        auto out = output + k * nh * nh;
+
+        std::fill(out, out + nh * nh, layer.biases[k]);
+
+        for(std::size_t c = 0; c < layer.nc; ++c){
+            auto in = input + c * nv * nv;
+            auto filter = layer.weights + (c * layer.k + k) * nw * nw;
+
+            for(std::size_t a = 0; a < nw; ++a){
+                for(std::size_t b = 0; b < nw; ++b){
+                    auto w = filter[a * nw + b];
+
+                    for(std::size_t i = 0; i < nh; ++i){
+                        auto out_row = out + i * nh;
+                        auto in_row = in + (i + a) * nv + b;
+
+                        for(std::size_t j = 0; j < nh; ++j){
+                            out_row[j] += w * in_row[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    dense_detail::activate(layer.activation, output, 1, layer.outputs());
+}
+
+/*!
+ * \brief Propagate one sample through the complete network
+ */
+inline void conv_forward(const conv_network& network, const float* input, float* output, dense_workspace& workspace){
+    auto width = network.max_width();
+
+    if(workspace.a.size() < width){
+        workspace.a.resize(width);
+        workspace.b.resize(width);
+    }
+
+    const float* current = input;
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        float* next = l + 1 == network.layers.size() ? output : (l % 2 == 0 ? workspace.a.data() : workspace.b.data());
+
+        conv_layer_forward(network.layers[l], current, next);
+
+        current = next;
+    }
+}
+
+/*!
+ * \brief Compute the features of many samples, in parallel.
+ * \param features The output, one row of network.output_size() per sample
+ */
+template<typename Samples, typename Features>
+void conv_extract(const conv_network& network, const Samples& samples, Features& features){
+    parallel_for_batches(samples.size(), 16, [&](std::size_t first, std::size_t last, std::size_t /*thread*/){
+        std::vector<float> input;
+        dense_workspace workspace;
+
+        for(std::size_t i = first; i < last; ++i){
+            gather_batch(samples, i, i + 1, network.input_size(), input);
+            conv_forward(network, input.data(), features[i].data(), workspace);
+        }
+    });
+}
+
+#endif
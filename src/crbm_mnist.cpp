@@ -11,8 +11,7 @@
 
 #include "etl/print.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
+#include "mnist_cache.hpp"
 
 int main(int argc, char* argv[]){
     auto reconstruction = false;
@@ -42,15 +41,13 @@ int main(int argc, char* argv[]){
         dll::visible<dll::unit_type::BINARY>
         >::layer_t rbm;
 
-    auto dataset = mnist::read_dataset<std::vector, std::vector, double>(1000);
+    auto dataset = read_cached_dataset<double>(1000, cache_mode::BINARIZE);
 
     if(dataset.training_images.empty() || dataset.training_labels.empty()){
         std::cout << "Impossible to read dataset" << std::endl;
         return 1;
     }
 
-    mnist::binarize_dataset(dataset);
-
     if(load){
         std::ifstream is("crbm-1.dat", std::ofstream::binary);
         rbm.load(is);
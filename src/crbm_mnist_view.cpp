@@ -11,32 +11,23 @@
 #include "dll/conv_rbm_mp.hpp"
 #include "dll/ocv_visualizer.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
+#include "async_visualizer.hpp"
+#include "mnist_cache.hpp"
+#include "telemetry.hpp"
 
 template<typename RBM>
 using visu = dll::opencv_rbm_visualizer<RBM, dll::rbm_ocv_config<20, true>>;
 
-int main(int argc, char* argv[]){
-    auto mp = false;
-
-    for(int i = 1; i < argc; ++i){
-        std::string command(argv[i]);
-
-        if(command == "mp"){
-            mp = true;
-        }
-    }
-
-    auto dataset = mnist::read_dataset<std::vector, std::vector, double>(1000);
+template<typename RBM>
+using async_visu = async_rbm_visualizer<RBM, async_ocv_config<20>>;
 
-    if(dataset.training_images.empty() || dataset.training_labels.empty()){
-        std::cout << "Impossible to read dataset" << std::endl;
-        return -1;
-    }
+template<typename RBM>
+using telemetry = telemetry_watcher<RBM>;
 
-    mnist::binarize_dataset(dataset);
+namespace {
 
+template<template<typename...> class Watcher, typename Dataset>
+void train(const Dataset& dataset, bool mp){
     if(!mp){
         dll::conv_rbm_desc_square<
             1, 28, 40, 12,
@@ -46,7 +37,7 @@ int main(int argc, char* argv[]){
             //dll::trainer<dll::pcd1_trainer_t>,
             dll::batch_size<50>,
             //dll::visible<dll::unit_type::GAUSSIAN>,
-            dll::watcher<visu>>::layer_t rbm;
+            dll::watcher<Watcher>>::layer_t rbm;
 
         rbm.pbias_lambda = 100;
 
@@ -65,7 +56,7 @@ int main(int argc, char* argv[]){
             //dll::trainer<dll::pcd1_trainer_t>,
             dll::batch_size<25>,
             //dll::visible<dll::unit_type::GAUSSIAN>,
-            dll::watcher<visu>>::layer_t rbm;
+            dll::watcher<Watcher>>::layer_t rbm;
 
         rbm.pbias_lambda = 1000;
 
@@ -77,6 +68,41 @@ int main(int argc, char* argv[]){
 
         rbm.train(dataset.training_images, 500, dll::init_watcher);
     }
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    auto mp = false;
+    auto async = false;
+    auto telemetry_log = false;
+
+    for(int i = 1; i < argc; ++i){
+        std::string command(argv[i]);
+
+        if(command == "mp"){
+            mp = true;
+        } else if(command == "async"){
+            async = true;
+        } else if(command == "telemetry"){
+            telemetry_log = true;
+        }
+    }
+
+    auto dataset = read_cached_dataset<double>(1000, cache_mode::BINARIZE);
+
+    if(dataset.training_images.empty() || dataset.training_labels.empty()){
+        std::cout << "Impossible to read dataset" << std::endl;
+        return -1;
+    }
+
+    if(telemetry_log){
+        train<telemetry>(dataset, mp);
+    } else if(async){
+        train<async_visu>(dataset, mp);
+    } else {
+        train<visu>(dataset, mp);
+    }
 
     return 0;
 }
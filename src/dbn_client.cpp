@@ -0,0 +1,154 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Load generator for dbn_server: several connections send the MNIST
+ * test images as fast as the server answers them. The client reports
+ * its own latencies and throughput, the accuracy of the answers and
+ * the counters of the server.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "dense_network.hpp"
+#include "mnist_cache.hpp"
+#include "prediction_server.hpp"
+
+namespace {
+
+/*!
+ * \brief Options of the client:
+ * --socket path, --connections N, --requests N (per connection)
+ */
+struct client_options {
+    std::string socket = "dbn.sock";
+    std::size_t connections = 4;
+    std::size_t requests = 1000;
+
+    static client_options parse(int argc, char* argv[]){
+        client_options options;
+
+        for(int i = 1; i + 1 < argc; i += 2){
+            std::string option(argv[i]);
+            std::string value(argv[i + 1]);
+
+            if(option == "--socket"){
+                options.socket = value;
+            } else if(option == "--connections"){
+                options.connections = std::max(1ul, std::stoul(value));
+            } else if(option == "--requests"){
+                options.requests = std::stoul(value);
+            } else {
+                std::cerr << "Unknown option " << option << std::endl;
+            }
+        }
+
+        return options;
+    }
+};
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    using clock_type = std::chrono::steady_clock;
+
+    auto options = client_options::parse(argc, argv);
+
+    auto dataset = read_cached_dataset<float>(100, cache_mode::BINARIZE);
+
+    if(dataset.test_images.empty()){
+        std::cerr << "Impossible to read dataset" << std::endl;
+        return 1;
+    }
+
+    auto& images = dataset.test_images;
+    auto& labels = dataset.test_labels;
+
+    std::mutex mutex;
+    std::vector<double> latencies;
+    std::size_t correct = 0;
+    std::size_t answered = 0;
+    std::atomic<bool> failed(false);
+
+    auto start = clock_type::now();
+
+    std::vector<std::thread> connections;
+
+    for(std::size_t c = 0; c < options.connections; ++c){
+        connections.emplace_back([&, c]{
+            auto fd = connect_server(options.socket);
+
+            if(fd < 0){
+                failed = true;
+                return;
+            }
+
+            std::vector<double> local_latencies;
+            std::vector<float> probabilities;
+            std::size_t local_correct = 0;
+
+            for(std::size_t r = 0; r < options.requests; ++r){
+                auto i = (c * options.requests + r) % images.size();
+
+                auto before = clock_type::now();
+
+                if(!remote_predict(fd, images[i], probabilities) || probabilities.empty()){
+                    failed = true;
+                    break;
+                }
+
+                local_latencies.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - before).count());
+                local_correct += dense_argmax(probabilities.data(), probabilities.size()) == labels[i];
+            }
+
+            ::close(fd);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.insert(latencies.end(), local_latencies.begin(), local_latencies.end());
+            correct += local_correct;
+            answered += local_latencies.size();
+        });
+    }
+
+    for(auto& connection : connections){
+        connection.join();
+    }
+
+    auto seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    if(failed){
+        std::cerr << "Some requests failed (is dbn_server listening on " << options.socket << "?)" << std::endl;
+    }
+
+    std::printf("client: %zu requests in %.3fs over %zu connections - throughput: %.1f requests/s - p50: %.1fus - p99: %.1fus - accuracy: %.2f%%\n",
+        answered, seconds, options.connections, answered / seconds, quantile(latencies, 0.50), quantile(latencies, 0.99),
+        answered ? 100.0 * correct / answered : 0.0);
+
+    auto fd = connect_server(options.socket);
+
+    server_stats stats;
+    if(fd >= 0 && remote_stats(fd, stats)){
+        std::printf("server: %lu requests in %lu batches (%.1f requests/batch) - throughput: %.1f requests/s - p50: %.1fus - p99: %.1fus\n",
+            static_cast<unsigned long>(stats.requests), static_cast<unsigned long>(stats.batches), stats.mean_batch,
+            stats.throughput, stats.p50_us, stats.p99_us);
+    }
+
+    if(fd >= 0){
+        ::close(fd);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file dbn_convert.hpp
+ * \brief Conversion of dll networks into the flat inference representations.
+ */
+
+#ifndef DBN_CONVERT_HPP
+#define DBN_CONVERT_HPP
+
+#include <type_traits>
+
+#include "dll/dbn.hpp"
+
+#include "conv_network.hpp"
+#include "dense_network.hpp"
+
+namespace convert_detail {
+
+template<typename T, typename Enable = void>
+struct is_dense_rbm : std::false_type {};
+
+template<typename T>
+struct is_dense_rbm<T, decltype(void(T::num_visible + T::num_hidden))> : std::true_type {};
+
+template<typename T, typename Enable = void>
+struct is_pooling_rbm : std::false_type {};
+
+template<typename T>
+struct is_pooling_rbm<T, decltype(void(T::C))> : std::true_type {};
+
+template<typename T, typename Enable = void>
+struct is_conv_rbm : std::false_type {};
+
+template<typename T>
+struct is_conv_rbm<T, decltype(void(T::NC + T::NV + T::NH + T::K))> : std::integral_constant<bool, !is_pooling_rbm<T>::value> {};
+
+template<typename RBM, typename Layer>
+struct is_layer_of : std::false_type {};
+
+template<typename RBM>
+struct is_layer_of<RBM, dense_layer> : is_dense_rbm<RBM> {};
+
+template<typename RBM>
+struct is_layer_of<RBM, conv_layer> : is_conv_rbm<RBM> {};
+
+//dll::dbn names its accessor layer_get while dll::conv_dbn names it layer
+
+template<std::size_t I, typename DBN>
+auto get_layer(DBN& dbn, int) -> decltype(dbn.template layer_get<I>()) {
+    return dbn.template layer_get<I>();
+}
+
+template<std::size_t I, typename DBN>
+auto get_layer(DBN& dbn, long) -> decltype(dbn.template layer<I>()) {
+    return dbn.template layer<I>();
+}
+
+inline bool dense_activation_of(dll::unit_type unit, dense_activation& activation){
+    switch(unit){
+        case dll::unit_type::BINARY:
+            activation = dense_activation::SIGMOID;
+            return true;
+        case dll::unit_type::SOFTMAX:
+            activation = dense_activation::SOFTMAX;
+            return true;
+        case dll::unit_type::RELU:
+            activation = dense_activation::RELU;
+            return true;
+        case dll::unit_type::GAUSSIAN:
+            activation = dense_activation::IDENTITY;
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<typename RBM>
+bool append_layer(const RBM& rbm, std::vector<dense_layer>& layers, std::vector<float>& weights, std::true_type){
+    dense_layer layer;
+    layer.inputs = RBM::num_visible;
+    layer.outputs = RBM::num_hidden;
+
+    if(!dense_activation_of(RBM::hidden_unit, layer.activation) || !dense_activation_of(RBM::visible_unit, layer.visible)){
+        return false;
+    }
+
+    if(!layers.empty() && layers.back().outputs != layer.inputs){
+        return false;
+    }
+
+    layers.push_back(layer);
+
+    for(std::size_t i = 0; i < RBM::num_visible; ++i){
+        for(std::size_t j = 0; j < RBM::num_hidden; ++j){
+            weights.push_back(rbm.w(i, j));
+        }
+    }
+
+    for(std::size_t j = 0; j < RBM::num_hidden; ++j){
+        weights.push_back(rbm.b(j));
+    }
+
+    for(std::size_t i = 0; i < RBM::num_visible; ++i){
+        weights.push_back(rbm.c(i));
+    }
+
+    return true;
+}
+
+template<typename RBM>
+bool append_layer(const RBM& rbm, std::vector<conv_layer>& layers, std::vector<float>& weights, std::true_type){
+    conv_layer layer;
+    layer.nc = RBM::NC;
+    layer.nv = RBM::NV;
+    layer.k = RBM::K;
+    layer.nh = RBM::NH;
+
+    if(!dense_activation_of(RBM::hidden_unit, layer.activation) || !dense_activation_of(RBM::visible_unit, layer.visible)){
+        return false;
+    }
+
+    if(!layers.empty() && layers.back().outputs() != layer.inputs()){
+        return false;
+    }
+
+    layers.push_back(layer);
+
+    auto nw = layer.nw();
+
+    for(std::size_t c = 0; c < RBM::NC; ++c){
+        for(std::size_t k = 0; k < RBM::K; ++k){
+            for(std::size_t a = 0; a < nw; ++a){
+                for(std::size_t b = 0; b < nw; ++b){
+                    weights.push_back(rbm.w(c, k, a, b));
+                }
+            }
+        }
+    }
+
+    for(std::size_t k = 0; k < RBM::K; ++k){
+        weights.push_back(rbm.b(k));
+    }
+
+    for(std::size_t c = 0; c < RBM::NC; ++c){
+        weights.push_back(rbm.c(c));
+    }
+
+    return true;
+}
+
+template<typename RBM, typename Layer>
+bool append_layer(const RBM& /*rbm*/, std::vector<Layer>& /*layers*/, std::vector<float>& /*weights*/, std::false_type){
+    return false;
+}
+
+template<typename DBN, typename Layer>
+bool append_layers(const DBN& /*dbn*/, std::vector<Layer>& /*layers*/, std::vector<float>& /*weights*/, std::integral_constant<std::size_t, DBN::layers>){
+    return true;
+}
+
+template<typename DBN, typename Layer, std::size_t I, std::enable_if_t<(I < DBN::layers), int> = 0>
+bool append_layers(const DBN& dbn, std::vector<Layer>& layers, std::vector<float>& weights, std::integral_constant<std::size_t, I>){
+    auto& rbm = get_layer<I>(dbn, 0);
+
+    using rbm_t = std::decay_t<decltype(rbm)>;
+
+    if(!append_layer(rbm, layers, weights, is_layer_of<rbm_t, Layer>())){
+        return false;
+    }
+
+    return append_layers(dbn, layers, weights, std::integral_constant<std::size_t, I + 1>());
+}
+
+inline void bind_weights(std::vector<dense_layer>& layers, const float* current){
+    for(auto& layer : layers){
+        layer.weights = current;
+        layer.biases = current + layer.inputs * layer.outputs;
+        layer.visible_biases = layer.biases + layer.outputs;
+        current = layer.visible_biases + layer.inputs;
+    }
+}
+
+inline void bind_weights(std::vector<conv_layer>& layers, const float* current){
+    for(auto& layer : layers){
+        layer.weights = current;
+        layer.biases = current + layer.nc * layer.k * layer.nw() * layer.nw();
+        layer.visible_biases = layer.biases + layer.k;
+        current = layer.visible_biases + layer.nc;
+    }
+}
+
+template<typename Network, typename DBN>
+Network make_network(const DBN& dbn){
+    Network network;
+
+    auto weights = std::make_shared<std::vector<float>>();
+
+    if(!append_layers(dbn, network.layers, *weights, std::integral_constant<std::size_t, 0>())){
+        network.layers.clear();
+        return network;
+    }
+
+    bind_weights(network.layers, weights->data());
+
+    network.storage = weights;
+
+    return network;
+}
+
+} //end of namespace convert_detail
+
+/*!
+ * \brief Copy the weights of a DBN made of dense RBMs into a dense_network.
+ *
+ * The returned network is empty if the DBN contains a layer that cannot
+ * be represented (convolutional layers, joint label layers or
+ * unsupported units).
+ */
+template<typename DBN>
+dense_network make_dense_network(const DBN& dbn){
+    return convert_detail::make_network<dense_network>(dbn);
+}
+
+/*!
+ * \brief Copy the weights of a DBN made of convolutional RBMs into a conv_network.
+ *
+ * The returned network is empty if the DBN contains a layer that cannot
+ * be represented (dense or max-pooling layers or unsupported units).
+ */
+template<typename DBN>
+conv_network make_conv_network(const DBN& dbn){
+    return convert_detail::make_network<conv_network>(dbn);
+}
+
+#endif
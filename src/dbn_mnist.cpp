@@ -5,6 +5,7 @@
 //  http://opensource.org/licenses/MIT)
 //=======================================================================
 
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <memory>
@@ -16,24 +17,16 @@
 #include "dll/test.hpp"
 #include "dll/ocv_visualizer.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
+#include "analysis.hpp"
+#include "async_visualizer.hpp"
+#include "binary_dataset.hpp"
+#include "checkpoint.hpp"
+#include "evaluation.hpp"
+#include "mnist_cache.hpp"
+#include "model_file.hpp"
 
 namespace {
 
-template<typename DBN, typename Dataset, typename P>
-void test_all(DBN& dbn, Dataset& dataset, P&& predictor){
-    std::cout << "Start testing" << std::endl;
-
-    std::cout << "Training Set" << std::endl;
-    auto error_rate = dll::test_set(dbn, dataset.training_images, dataset.training_labels, predictor);
-    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
-
-    std::cout << "Test Set" << std::endl;
-    error_rate =  dll::test_set(dbn, dataset.test_images, dataset.test_labels, predictor);
-    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
-}
-
 template<typename DBN, typename Image>
 void display(const DBN& dbn, const Image& image){
     auto weights = dbn->activation_probabilities(image);
@@ -55,64 +48,83 @@ void display(const DBN& dbn, const Image& image){
 
 template<typename DBN, typename Images, typename Labels>
 void errors(const DBN& dbn, Images& images, Labels& labels){
-    std::size_t types[100];
-    std::size_t sources[10];
-    std::size_t errors = 0;
-    std::size_t second_errors = 0;
+    auto network = make_dense_network(*dbn);
 
-    std::fill(&types[0], &types[100], 0);
-    std::fill(&sources[0], &sources[10], 0);
+    classification_report report;
 
-    for(std::size_t i = 0; i < images.size(); ++i){
-        auto predicted = dbn->predict(images[i]);
+    if(network.empty()){
+        report = classification_report(10, 3);
 
-        if(predicted != labels[i]){
+        for(std::size_t i = 0; i < images.size(); ++i){
             auto weights = dbn->activation_probabilities(images[i]);
-            auto max = 0.0;
-            auto second = 0;
-
-            for(std::size_t j = 0; j < weights.size(); ++j){
-                if(j != predicted && weights[j] > max){
-                    second = j;
-                    max = weights[j];
-                }
-            }
-
-            if(second == labels[i]){
-                ++second_errors;
-            }
 
-            ++errors;
-            ++types[labels[i] * 10 + predicted];
-            ++sources[labels[i]];
+            std::vector<float> probabilities(weights.begin(), weights.end());
+            report.add(probabilities.data(), labels[i]);
         }
+    } else {
+        report = dense_analysis(network, images, labels, 3);
     }
 
-    std::cout << "Error rate " << 100.0 * (static_cast<double>(errors) / images.size()) << std::endl;
-    std::cout << errors << " errors " << " / " << images.size() << std::endl;
-    std::cout << "Second guess error rate " << 100.0 * ((static_cast<double>(errors) - second_errors) / images.size()) << std::endl;
-    std::cout << "Second guess was right " << second_errors << " / " << images.size() << std::endl;
+    report.display();
+}
+
+/*!
+ * \brief Compare the evaluation of the test set on the float images and
+ * on the bit-packed images.
+ */
+template<typename DBN, typename Dataset>
+void packed_test(const DBN& dbn, const Dataset& dataset){
+    auto network = make_dense_network(*dbn);
 
-    std::cout << "Errors sources: ";
-    for(std::size_t i = 0; i < 10; ++i){
-        std::cout << i << ":" << sources[i] << " ";
+    if(network.empty()){
+        return;
     }
-    std::cout << std::endl;
 
-    std::cout << "Error matrix" << std::endl;
-    std::cout << "   ";
-    for(std::size_t i = 0; i < 10; ++i){
-        std::cout << std::setw(3) << i << " ";
-    }
-    std::cout << std::endl;
-    for(std::size_t i = 0; i < 10; ++i){
-        std::cout << i << ": ";
-        for(std::size_t j = 0; j < 10; ++j){
-            std::cout << std::setw(3) << types[i * 10 + j] << " ";
+    auto packed = pack_dataset(dataset);
+
+    std::cout << "Packed images: " << packed.test_images.stride << " bytes per image instead of "
+              << network.input_size() * sizeof(float) << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    auto dense_error = dense_test_set(network, dataset.test_images, dataset.test_labels);
+    auto middle = std::chrono::steady_clock::now();
+    auto packed_error = binary_test_set(network, packed.test_images, packed.test_labels);
+    auto end = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::milliseconds;
+
+    std::cout << "Test Set" << std::endl;
+    std::cout << "\tError rate (float): " << 100.0 * dense_error << " in " << std::chrono::duration_cast<ms>(middle - start).count() << "ms" << std::endl;
+    std::cout << "\tError rate (packed): " << 100.0 * packed_error << " in " << std::chrono::duration_cast<ms>(end - middle).count() << "ms" << std::endl;
+}
+
+/*!
+ * \brief The int8 version of the DBN, for the scoring.
+ *
+ * It is read from path when the file matches the DBN and the DBN has not
+ * just been trained. Otherwise, the DBN is quantized, calibrated on
+ * images, and saved to path so that the following runs read it.
+ */
+template<typename DBN, typename Images>
+quantized_network int8_network(const DBN& dbn, const Images& images, const std::string& path, bool trained){
+    if(!trained && std::ifstream(path)){
+        auto quantized = read_quantized_model_file(path, dbn);
+
+        if(!quantized.empty()){
+            std::cout << "Read the int8 network from " << path << std::endl;
+            return quantized;
         }
-        std::cout << std::endl;
     }
-    std::cout << std::endl;
+
+    std::cout << "Quantize the network into " << path << std::endl;
+
+    auto quantized = quantize_network(make_dense_network(dbn), images);
+
+    if(!quantized.empty()){
+        write_model_file(quantized, path);
+    }
+
+    return quantized;
 }
 
 } //end of anonymous namespace
@@ -125,6 +137,11 @@ int main(int argc, char* argv[]){
     auto gray = false;
     auto prob = false;
     auto view = false;
+    auto async = false;
+    auto checkpoint = false;
+    auto resume = false;
+    auto packed = false;
+    auto quantize = false;
 
     for(int i = 1; i < argc; ++i){
         std::string command(argv[i]);
@@ -143,19 +160,39 @@ int main(int argc, char* argv[]){
             prob = true;
         } else if(command == "view"){
             view = true;
+        } else if(command == "async"){
+            view = true;
+            async = true;
+        } else if(command == "checkpoint"){
+            checkpoint = true;
+        } else if(command == "resume"){
+            checkpoint = true;
+            resume = true;
+        } else if(command == "packed"){
+            packed = true;
+        } else if(command == "quantize"){
+            quantize = true;
         }
     }
 
-    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(100);
+    auto dataset = read_cached_dataset<float>(100, gray ? cache_mode::NORMALIZE : cache_mode::BINARIZE);
 
     if(dataset.training_images.empty() || dataset.training_labels.empty()){
         return 1;
     }
 
+    auto pretrain = [&](auto& dbn, std::size_t epochs, const std::string& path){
+        std::cout << "Start pretraining" << std::endl;
+
+        if(checkpoint){
+            checkpointed_pretrain(dbn, dataset.training_images, epochs, path, checkpoint_policy::parse(argc, argv), resume);
+        } else {
+            dbn.pretrain(dataset.training_images, epochs);
+        }
+    };
+
     //Gray input
     if(gray){
-        mnist::normalize_dataset(dataset);
-
         if(simple){
             typedef dll::dbn_desc<
                 dll::dbn_label_layers<
@@ -170,74 +207,102 @@ int main(int argc, char* argv[]){
 
             test_all(dbn, dataset, dll::label_predictor());
         } else {
-            typedef dll::dbn_desc<
-                dll::dbn_layers<
-                dll::rbm_desc<28 * 28, 300, dll::momentum, dll::batch_size<100>, dll::init_weights, dll::visible<dll::unit_type::GAUSSIAN>>::layer_t,
-                dll::rbm_desc<300, 500, dll::momentum, dll::batch_size<100>>::layer_t,
-                dll::rbm_desc<500, 10, dll::momentum, dll::batch_size<100>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
-                    >>::dbn_t dbn_t;
-
-            auto dbn = std::make_unique<dbn_t>();
-
-            dbn->display();
+            auto run = [&](auto& dbn){
+                dbn->display();
 
-            if(load){
-                std::cout << "Load from file" << std::endl;
+                if(load){
+                    std::cout << "Load from file" << std::endl;
 
-                std::ifstream is("dbn_gray.dat", std::ifstream::binary);
-                dbn->load(is);
-            } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 20);
-
-                std::cout << "Start fine-tuning" << std::endl;
-                dbn->fine_tune(dataset.training_images, dataset.training_labels, 2);
-
-                std::ofstream os("dbn_gray.dat", std::ofstream::binary);
-                dbn->store(os);
-            }
+                    std::ifstream is("dbn_gray.dat", std::ifstream::binary);
+                    dbn->load(is);
+                } else {
+                    pretrain(*dbn, 20, "dbn_gray.ckpt");
 
-            if(prob){
-                display(dbn, dataset.training_images[256]);
-                display(dbn, dataset.training_images[512]);
-                display(dbn, dataset.training_images[666]);
-                display(dbn, dataset.training_images[1024]);
-                display(dbn, dataset.training_images[2048]);
+                    std::cout << "Start fine-tuning" << std::endl;
+                    dbn->fine_tune(dataset.training_images, dataset.training_labels, 2);
 
-                std::cout << std::endl << "Results on training dataset" << std::endl;
-                errors(dbn, dataset.training_images, dataset.training_labels);
+                    std::ofstream os("dbn_gray.dat", std::ofstream::binary);
+                    dbn->store(os);
+                }
 
-                std::cout << std::endl << "Results on test dataset" << std::endl;
-                errors(dbn, dataset.test_images, dataset.test_labels);
+                if(prob){
+                    display(dbn, dataset.training_images[256]);
+                    display(dbn, dataset.training_images[512]);
+                    display(dbn, dataset.training_images[666]);
+                    display(dbn, dataset.training_images[1024]);
+                    display(dbn, dataset.training_images[2048]);
+
+                    std::cout << std::endl << "Results on training dataset" << std::endl;
+                    errors(dbn, dataset.training_images, dataset.training_labels);
+
+                    std::cout << std::endl << "Results on test dataset" << std::endl;
+                    errors(dbn, dataset.test_images, dataset.test_labels);
+                } else if(quantize){
+                    auto quantized = int8_network(*dbn, dataset.training_images, "dbn_gray.int8.model", !load);
+                    test_all(dbn, dataset, dll::predictor(), &quantized);
+                } else {
+                    test_all(dbn, dataset, dll::predictor());
+                }
+            };
+
+            if(!checkpoint){
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 300, dll::momentum, dll::batch_size<100>, dll::init_weights, dll::visible<dll::unit_type::GAUSSIAN>>::layer_t,
+                    dll::rbm_desc<300, 500, dll::momentum, dll::batch_size<100>>::layer_t,
+                    dll::rbm_desc<500, 10, dll::momentum, dll::batch_size<100>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                        >>::dbn_t dbn_t;
+
+                auto dbn = std::make_unique<dbn_t>();
+                run(dbn);
             } else {
-                test_all(dbn, dataset, dll::predictor());
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 300, dll::momentum, dll::batch_size<100>, dll::init_weights, dll::visible<dll::unit_type::GAUSSIAN>>::layer_t,
+                    dll::rbm_desc<300, 500, dll::momentum, dll::batch_size<100>>::layer_t,
+                    dll::rbm_desc<500, 10, dll::momentum, dll::batch_size<100>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                        >, dll::watcher<checkpoint_dbn_watcher>>::dbn_t dbn_t;
+
+                auto dbn = std::make_unique<dbn_t>();
+                run(dbn);
             }
         }
     } else if(view){
-        mnist::binarize_dataset(dataset);
+        auto train_view = [&](auto& dbn){
+            dbn.display();
 
-        typedef dll::dbn_desc<
-            dll::dbn_layers<
-            dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
-            dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
-            dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
-                >, dll::watcher<dll::opencv_dbn_visualizer>>::dbn_t dbn_t;
+            std::cout << "Start pretraining" << std::endl;
+            dbn.pretrain(dataset.training_images, 10);
 
-        auto dbn = std::make_unique<dbn_t>();
+            std::cout << "Start fine-tuning" << std::endl;
+            dbn.fine_tune(dataset.training_images, dataset.training_labels, 5);
 
-        dbn->display();
+            std::ofstream os("dbn.dat", std::ofstream::binary);
+            dbn.store(os);
+        };
 
-        std::cout << "Start pretraining" << std::endl;
-        dbn->pretrain(dataset.training_images, 10);
+        if(!async){
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
+                dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                    >, dll::watcher<dll::opencv_dbn_visualizer>>::dbn_t dbn_t;
 
-        std::cout << "Start fine-tuning" << std::endl;
-        dbn->fine_tune(dataset.training_images, dataset.training_labels, 5);
+            auto dbn = std::make_unique<dbn_t>();
+            train_view(*dbn);
+        } else {
+            typedef dll::dbn_desc<
+                dll::dbn_layers<
+                dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
+                dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                    >, dll::watcher<async_dbn_visualizer>>::dbn_t dbn_t;
 
-        std::ofstream os("dbn.dat", std::ofstream::binary);
-        dbn->store(os);
+            auto dbn = std::make_unique<dbn_t>();
+            train_view(*dbn);
+        }
     } else {
-        mnist::binarize_dataset(dataset);
-
         if(simple){
             typedef dll::dbn_desc<
                 dll::dbn_label_layers<
@@ -251,66 +316,114 @@ int main(int argc, char* argv[]){
             dbn->train_with_labels(dataset.training_images, dataset.training_labels, 10, 5);
 
             test_all(dbn, dataset, dll::label_predictor());
-        } else if(svm){ typedef dll::dbn_desc<
-            dll::dbn_layers<
-                dll::rbm_desc<28 * 28, 400, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
-                dll::rbm_desc<400, 600, dll::momentum, dll::batch_size<50>>::layer_t
-                    >>::dbn_t dbn_t;
-
-            auto dbn = std::make_unique<dbn_t>();
-
-            dbn->display();
-
-            if(load){
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
-            } else {
-                dbn->pretrain(dataset.training_images, 20);
+        } else if(svm){
+            auto run = [&](auto& dbn){
+                dbn->display();
 
-                if(grid){
-                    dbn->svm_grid_search(dataset.training_images, dataset.training_labels);
+                if(load){
+                    std::ifstream is("dbn.dat", std::ifstream::binary);
+                    dbn->load(is);
                 } else {
-                    if(!dbn->svm_train(dataset.training_images, dataset.training_labels)){
-                        std::cout << "SVM training failed" << std::endl;
+                    pretrain(*dbn, 20, "dbn_svm.ckpt");
+
+                    if(grid){
+                        dbn->svm_grid_search(dataset.training_images, dataset.training_labels);
+                    } else {
+                        if(!dbn->svm_train(dataset.training_images, dataset.training_labels)){
+                            std::cout << "SVM training failed" << std::endl;
+                        }
                     }
+
+                    std::ofstream os("dbn.dat", std::ofstream::binary);
+                    dbn->store(os);
                 }
 
-                std::ofstream os("dbn.dat", std::ofstream::binary);
-                dbn->store(os);
-            }
+                if(!grid){
+                    test_all(dbn, dataset, dll::svm_predictor());
+                }
+            };
+
+            if(!checkpoint){
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 400, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                    dll::rbm_desc<400, 600, dll::momentum, dll::batch_size<50>>::layer_t
+                        >>::dbn_t dbn_t;
 
-            if(!grid){
-                test_all(dbn, dataset, dll::svm_predictor());
+                auto dbn = std::make_unique<dbn_t>();
+                run(dbn);
+            } else {
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 400, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                    dll::rbm_desc<400, 600, dll::momentum, dll::batch_size<50>>::layer_t
+                        >, dll::watcher<checkpoint_dbn_watcher>>::dbn_t dbn_t;
+
+                auto dbn = std::make_unique<dbn_t>();
+                run(dbn);
             }
         } else {
-            typedef dll::dbn_desc<
-                dll::dbn_layers<
-                dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
-                dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
-                dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
-                    >, dll::watcher<dll::default_dbn_watcher>>::dbn_t dbn_t;
+            auto run = [&](auto& dbn){
+                dbn->display();
+
+                if(load){
+                    std::cout << "Load from file" << std::endl;
+
+                    if(std::ifstream("dbn.model")){
+                        if(!load_model_file("dbn.model", *dbn)){
+                            return 1;
+                        }
+                    } else {
+                        std::ifstream is("dbn.dat", std::ifstream::binary);
+                        dbn->load(is);
+                    }
+                } else {
+                    pretrain(*dbn, 10, "dbn.ckpt");
 
-            auto dbn = std::make_unique<dbn_t>();
+                    std::cout << "Start fine-tuning" << std::endl;
+                    dbn->fine_tune(dataset.training_images, dataset.training_labels, 5);
 
-            dbn->display();
+                    std::ofstream os("dbn.dat", std::ofstream::binary);
+                    dbn->store(os);
 
-            if(load){
-                std::cout << "Load from file" << std::endl;
+                    save_model_file(*dbn, "dbn.model");
+                }
 
-                std::ifstream is("dbn.dat", std::ifstream::binary);
-                dbn->load(is);
-            } else {
-                std::cout << "Start pretraining" << std::endl;
-                dbn->pretrain(dataset.training_images, 10);
+                if(quantize){
+                    auto quantized = int8_network(*dbn, dataset.training_images, "dbn.int8.model", !load);
+                    test_all(dbn, dataset, dll::predictor(), &quantized);
+                } else {
+                    test_all(dbn, dataset, dll::predictor());
+                }
 
-                std::cout << "Start fine-tuning" << std::endl;
-                dbn->fine_tune(dataset.training_images, dataset.training_labels, 5);
+                if(packed){
+                    packed_test(dbn, dataset);
+                }
 
-                std::ofstream os("dbn.dat", std::ofstream::binary);
-                dbn->store(os);
-            }
+                return 0;
+            };
+
+            if(!checkpoint){
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                    dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
+                    dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                        >, dll::watcher<dll::default_dbn_watcher>>::dbn_t dbn_t;
 
-            test_all(dbn, dataset, dll::predictor());
+                auto dbn = std::make_unique<dbn_t>();
+                return run(dbn);
+            } else {
+                typedef dll::dbn_desc<
+                    dll::dbn_layers<
+                    dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+                    dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
+                    dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+                        >, dll::watcher<checkpoint_dbn_watcher>>::dbn_t dbn_t;
+
+                auto dbn = std::make_unique<dbn_t>();
+                return run(dbn);
+            }
         }
     }
 
@@ -0,0 +1,506 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Prediction server: the network is loaded once and the samples sent
+ * over a UNIX socket are answered with their class probabilities.
+ *
+ * The concurrent requests are grouped into micro-batches: a batch is
+ * started when max-batch requests are waiting or when the oldest one
+ * has waited for budget-us microseconds, and is propagated with the
+ * batched dense engine, or with the int8 engine when an int8 model
+ * file is given with --int8.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dll/rbm.hpp"
+#include "dll/dbn.hpp"
+
+#include "dbn_convert.hpp"
+#include "dense_network.hpp"
+#include "model_file.hpp"
+#include "parallel.hpp"
+#include "prediction_server.hpp"
+#include "quantized_network.hpp"
+
+namespace {
+
+//The network of dbn_mnist, to read dbn.dat when there is no model file
+typedef dll::dbn_desc<
+    dll::dbn_layers<
+    dll::rbm_desc<28 * 28, 100, dll::momentum, dll::batch_size<50>, dll::init_weights>::layer_t,
+    dll::rbm_desc<100, 200, dll::momentum, dll::batch_size<50>>::layer_t,
+    dll::rbm_desc<200, 10, dll::momentum, dll::batch_size<50>, dll::hidden<dll::unit_type::SOFTMAX>>::layer_t
+        >>::dbn_t dbn_t;
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr const std::size_t latency_window = 100000;
+
+/*!
+ * \brief Options of the server:
+ * --socket path, --model file, --dat file, --int8 file, --max-batch N,
+ * --budget-us N, --workers N, --report seconds
+ */
+struct server_options {
+    std::string socket = "dbn.sock";
+    std::string model = "dbn.model";
+    std::string dat = "dbn.dat";
+    std::string int8;   ///< int8 model file to serve instead of the float network, if not empty
+    std::size_t max_batch = 64;
+    std::size_t budget_us = 2000;
+    std::size_t workers = default_threads();
+    std::size_t report = 10; ///< Seconds between two reports of the counters, 0 to disable
+
+    static server_options parse(int argc, char* argv[]){
+        server_options options;
+
+        for(int i = 1; i + 1 < argc; i += 2){
+            std::string option(argv[i]);
+            std::string value(argv[i + 1]);
+
+            if(option == "--socket"){
+                options.socket = value;
+            } else if(option == "--model"){
+                options.model = value;
+            } else if(option == "--dat"){
+                options.dat = value;
+            } else if(option == "--int8"){
+                options.int8 = value;
+            } else if(option == "--max-batch"){
+                options.max_batch = std::max(1ul, std::stoul(value));
+            } else if(option == "--budget-us"){
+                options.budget_us = std::stoul(value);
+            } else if(option == "--workers"){
+                options.workers = std::max(1ul, std::stoul(value));
+            } else if(option == "--report"){
+                options.report = std::stoul(value);
+            } else {
+                std::cerr << "Unknown option " << option << std::endl;
+            }
+        }
+
+        return options;
+    }
+};
+
+/*!
+ * \brief The network being served, in single precision or in int8
+ */
+struct served_network {
+    dense_network dense;
+    quantized_network quantized;
+
+    bool empty() const {
+        return dense.empty() && quantized.empty();
+    }
+
+    std::size_t input_size() const {
+        return quantized.empty() ? dense.input_size() : quantized.input_size();
+    }
+
+    std::size_t output_size() const {
+        return quantized.empty() ? dense.output_size() : quantized.output_size();
+    }
+};
+
+struct pending_request {
+    const std::vector<float>* sample;
+    clock_type::time_point arrival;
+    std::promise<std::vector<float>> result;
+};
+
+/*!
+ * \brief Group the pending requests into batches, processed by a pool
+ * of workers.
+ */
+struct batcher {
+    batcher(const served_network& network, const server_options& options) : network(network), options(options), start(clock_type::now()) {
+        latencies.reserve(latency_window);
+
+        for(std::size_t t = 0; t < options.workers; ++t){
+            workers.emplace_back([this]{ run(); });
+        }
+    }
+
+    ~batcher(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+
+        condition.notify_all();
+
+        for(auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    std::future<std::vector<float>> submit(pending_request& request){
+        auto future = request.result.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(&request);
+        }
+
+        condition.notify_one();
+
+        return future;
+    }
+
+    server_stats stats(){
+        std::vector<double> window;
+        server_stats stats;
+
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            window = latencies;
+            stats.requests = requests;
+            stats.batches = batches;
+        }
+
+        stats.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+        stats.throughput = stats.seconds > 0.0 ? stats.requests / stats.seconds : 0.0;
+        stats.p50_us = quantile(window, 0.50);
+        stats.p99_us = quantile(window, 0.99);
+        stats.mean_batch = stats.batches ? static_cast<double>(stats.requests) / stats.batches : 0.0;
+
+        return stats;
+    }
+
+private:
+    void run(){
+        std::vector<pending_request*> batch;
+        std::vector<float> input;
+        std::vector<float> output;
+        dense_workspace workspace;
+        quantized_workspace quantized_workspace;
+
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                //Wait for more requests until the batch is full or the oldest request is out of budget.
+                //Another worker may take the requests while this one waits, so the deadline is
+                //recomputed from the current oldest request after each wake-up
+                while(true){
+                    condition.wait(lock, [this]{ return !queue.empty() || done; });
+
+                    if(queue.empty() || queue.size() >= options.max_batch || done){
+                        break;
+                    }
+
+                    auto deadline = queue.front()->arrival + std::chrono::microseconds(options.budget_us);
+
+                    if(clock_type::now() >= deadline){
+                        break;
+                    }
+
+                    condition.wait_until(lock, deadline);
+                }
+
+                if(queue.empty()){
+                    break;
+                }
+
+                auto n = std::min(queue.size(), options.max_batch);
+                batch.assign(queue.begin(), queue.begin() + n);
+                queue.erase(queue.begin(), queue.begin() + n);
+
+                //The remaining requests need another worker
+                if(!queue.empty()){
+                    condition.notify_one();
+                }
+            }
+
+            auto inputs = network.input_size();
+            auto outputs = network.output_size();
+
+            input.resize(batch.size() * inputs);
+            output.resize(batch.size() * outputs);
+
+            for(std::size_t i = 0; i < batch.size(); ++i){
+                std::copy(batch[i]->sample->begin(), batch[i]->sample->end(), input.begin() + i * inputs);
+            }
+
+            if(network.quantized.empty()){
+                dense_forward(network.dense, input.data(), batch.size(), output.data(), workspace);
+            } else {
+                quantized_forward(network.quantized, input.data(), batch.size(), output.data(), quantized_workspace);
+            }
+
+            auto end = clock_type::now();
+
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+
+                for(auto* request : batch){
+                    auto latency = std::chrono::duration<double, std::micro>(end - request->arrival).count();
+
+                    if(latencies.size() < latency_window){
+                        latencies.push_back(latency);
+                    } else {
+                        latencies[requests % latency_window] = latency;
+                    }
+
+                    ++requests;
+                }
+
+                ++batches;
+            }
+
+            for(std::size_t i = 0; i < batch.size(); ++i){
+                auto first = output.begin() + i * outputs;
+                batch[i]->result.set_value(std::vector<float>(first, first + outputs));
+            }
+        }
+    }
+
+    const served_network& network;
+    const server_options& options;
+    clock_type::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<pending_request*> queue;
+    bool done = false;
+
+    std::mutex stats_mutex;
+    std::vector<double> latencies; ///< The latencies of the last requests, in microseconds
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+
+    std::vector<std::thread> workers;
+};
+
+void print_stats(const server_stats& stats){
+    std::printf("requests: %lu - batches: %lu (%.1f requests/batch) - throughput: %.1f requests/s - p50: %.1fus - p99: %.1fus\n",
+        static_cast<unsigned long>(stats.requests), static_cast<unsigned long>(stats.batches), stats.mean_batch,
+        stats.throughput, stats.p50_us, stats.p99_us);
+    std::fflush(stdout);
+}
+
+/*!
+ * \brief Answer the requests of one client until it disconnects
+ */
+void serve_client(int fd, const served_network& network, batcher& batcher){
+    std::vector<float> sample;
+
+    while(true){
+        request_header header;
+        if(!server_detail::read_full(fd, &header, sizeof(header))){
+            break;
+        }
+
+        if(header.type == request_type::STATS && header.size == 0){
+            auto stats = batcher.stats();
+            if(!server_detail::write_full(fd, &stats, sizeof(stats))){
+                break;
+            }
+
+            continue;
+        }
+
+        //The size is checked before anything is allocated, a malformed request closes the connection
+        if(header.type != request_type::PREDICT || header.size != network.input_size()){
+            break;
+        }
+
+        sample.resize(header.size);
+        if(!server_detail::read_full(fd, sample.data(), sample.size() * sizeof(float))){
+            break;
+        }
+
+        pending_request request;
+        request.sample = &sample;
+        request.arrival = clock_type::now();
+
+        auto probabilities = batcher.submit(request).get();
+
+        uint32_t count = probabilities.size();
+        if(!server_detail::write_full(fd, &count, sizeof(count)) || !server_detail::write_full(fd, probabilities.data(), count * sizeof(float))){
+            break;
+        }
+    }
+}
+
+std::atomic<int> listen_fd(-1);
+
+void stop(int /*signal*/){
+    //Wakes up accept(), which makes the server stop
+    ::shutdown(listen_fd, SHUT_RDWR);
+}
+
+dense_network load_dense_network(const server_options& options){
+    //The model file of another experiment (a convolutional DBN for instance) is skipped
+    if(std::ifstream(options.model)){
+        std::cout << "Map " << options.model << std::endl;
+
+        auto network = map_model_file<dense_network>(options.model);
+
+        if(!network.empty()){
+            return network;
+        }
+
+        std::cout << options.model << " is not usable, fall back to " << options.dat << std::endl;
+    }
+
+    std::ifstream is(options.dat, std::ifstream::binary);
+
+    if(!is){
+        return {};
+    }
+
+    std::cout << "Load " << options.dat << std::endl;
+
+    auto dbn = std::make_unique<dbn_t>();
+    dbn->load(is);
+
+    return make_dense_network(*dbn);
+}
+
+served_network load_network(const server_options& options){
+    served_network network;
+
+    if(!options.int8.empty()){
+        std::cout << "Read " << options.int8 << std::endl;
+        network.quantized = read_quantized_model_file(options.int8);
+    } else {
+        network.dense = load_dense_network(options);
+    }
+
+    return network;
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    auto options = server_options::parse(argc, argv);
+
+    auto network = load_network(options);
+
+    if(network.empty()){
+        std::cerr << "Impossible to load the network" << std::endl;
+        return 1;
+    }
+
+    sockaddr_un address;
+    if(!server_detail::make_address(options.socket, address)){
+        std::cerr << "Invalid socket path " << options.socket << std::endl;
+        return 1;
+    }
+
+    ::unlink(options.socket.c_str());
+
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listen_fd, 128) != 0){
+        std::cerr << "Impossible to listen on " << options.socket << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    std::cout << "Listening on " << options.socket << " (" << network.input_size() << " inputs, " << network.output_size()
+              << " outputs, max batch " << options.max_batch << ", budget " << options.budget_us << "us, "
+              << options.workers << " workers)" << std::endl;
+
+    batcher batcher(network, options);
+
+    std::mutex clients_mutex;
+    std::condition_variable clients_done;
+    std::set<int> clients;
+
+    auto running = true;
+    std::mutex report_mutex;
+    std::condition_variable report_condition;
+
+    std::thread reporter([&]{
+        if(!options.report){
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(report_mutex);
+        while(!report_condition.wait_for(lock, std::chrono::seconds(options.report), [&]{ return !running; })){
+            print_stats(batcher.stats());
+        }
+    });
+
+    while(true){
+        auto fd = ::accept(listen_fd, nullptr, nullptr);
+
+        if(fd < 0){
+            if(errno == EINTR){
+                continue;
+            }
+
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            clients.insert(fd);
+        }
+
+        std::thread([&, fd]{
+            serve_client(fd, network, batcher);
+
+            //The descriptor is closed under the lock so that it is not reused before being erased
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            clients.erase(fd);
+            ::close(fd);
+            clients_done.notify_all();
+        }).detach();
+    }
+
+    //Disconnect the remaining clients and wait for their threads
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+
+        for(auto fd : clients){
+            ::shutdown(fd, SHUT_RDWR);
+        }
+
+        clients_done.wait(lock, [&]{ return clients.empty(); });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        running = false;
+    }
+
+    report_condition.notify_all();
+    reporter.join();
+
+    print_stats(batcher.stats());
+
+    ::close(listen_fd);
+    ::unlink(options.socket.c_str());
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file dense_network.hpp
+ * \brief Flat, inference-only representation of a stack of dense RBMs.
+ *
+ * The weights of each layer are stored row-major (inputs x outputs) in
+ * single precision, which makes it possible to propagate a whole batch
+ * of samples with matrix-matrix products.
+ */
+
+#ifndef DENSE_NETWORK_HPP
+#define DENSE_NETWORK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*!
+ * \brief The activation function of a dense layer
+ */
+enum class dense_activation : uint32_t {
+    SIGMOID  = 0,
+    SOFTMAX  = 1,
+    RELU     = 2,
+    IDENTITY = 3
+};
+
+/*!
+ * \brief One layer of a dense network. The layer does not own its weights.
+ *
+ * The visible units are not used for inference, they are only kept to
+ * restore the RBM the layer comes from (see model_file.hpp).
+ */
+struct dense_layer {
+    std::size_t inputs;
+    std::size_t outputs;
+    dense_activation activation;
+    const float* weights;         ///< inputs x outputs, row-major
+    const float* biases;          ///< outputs
+    dense_activation visible;     ///< Activation of the visible units
+    const float* visible_biases;  ///< inputs
+};
+
+/*!
+ * \brief A stack of dense layers with the storage of their weights
+ */
+struct dense_network {
+    std::vector<dense_layer> layers;
+    std::shared_ptr<const void> storage; ///< Keeps the weights alive
+
+    bool empty() const {
+        return layers.empty();
+    }
+
+    std::size_t input_size() const {
+        return layers.front().inputs;
+    }
+
+    std::size_t output_size() const {
+        return layers.back().outputs;
+    }
+
+    std::size_t max_width() const {
+        std::size_t width = 0;
+        for(auto& layer : layers){
+            width = std::max(width, std::max(layer.inputs, layer.outputs));
+        }
+        return width;
+    }
+};
+
+/*!
+ * \brief Temporary buffers for the propagation of a batch
+ */
+struct dense_workspace {
+    std::vector<float> a;
+    std::vector<float> b;
+
+    void prepare(const dense_network& network, std::size_t batch){
+        auto size = batch * network.max_width();
+
+        if(a.size() < size){
+            a.resize(size);
+            b.resize(size);
+        }
+    }
+};
+
+namespace dense_detail {
+
+constexpr const std::size_t row_block = 32;
+
+inline void activate(dense_activation activation, float* output, std::size_t batch, std::size_t outputs){
+    switch(activation){
+        case dense_activation::SIGMOID:
+            for(std::size_t i = 0; i < batch * outputs; ++i){
+                output[i] = 1.0f / (1.0f + std::exp(-output[i]));
+            }
+            break;
+
+        case dense_activation::RELU:
+            for(std::size_t i = 0; i < batch * outputs; ++i){
+                output[i] = std::max(0.0f, output[i]);
+            }
+            break;
+
+        case dense_activation::SOFTMAX:
+            for(std::size_t i = 0; i < batch; ++i){
+                auto row = output + i * outputs;
+                auto max = *std::max_element(row, row + outputs);
+                float sum = 0.0f;
+                for(std::size_t j = 0; j < outputs; ++j){
+                    row[j] = std::exp(row[j] - max);
+                    sum += row[j];
+                }
+                for(std::size_t j = 0; j < outputs; ++j){
+                    row[j] /= sum;
+                }
+            }
+            break;
+
+        case dense_activation::IDENTITY:
+            break;
+    }
+}
+
+} //end of namespace dense_detail
+
+/*!
+ * \brief Compute the activation probabilities of one layer for a batch.
+ *
+ * The weights are consumed by blocks of rows so that a block stays in
+ * cache while it is applied to every sample of the batch. Zero inputs,
+ * very common with binary units, are skipped.
+ */
+inline void dense_layer_forward(const dense_layer& layer, const float* input, std::size_t batch, float* output){
+    auto n_in = layer.inputs;
+    auto n_out = layer.outputs;
+
+    for(std::size_t i = 0; i < batch; ++i){
+        std::copy(layer.biases, layer.biases + n_out, output + i * n_out);
+    }
+
+    for(std::size_t kb = 0; kb < n_in; kb += dense_detail::row_block){
+        auto k_last = std::min(n_in, kb + dense_detail::row_block);
+
+        for(std::size_t i = 0; i < batch; ++i){
+            auto in = input + i * n_in;
+            auto out = output + i * n_out;
+
+            for(std::size_t k = kb; k < k_last; ++k){
+                auto x = in[k];
+
+                if(x == 0.0f){
+                    continue;
+                }
+
+                auto w = layer.weights + k * n_out;
+
+                for(std::size_t j = 0; j < n_out; ++j){
+                    out[j] += x * w[j];
+                }
+            }
+        }
+    }
+
+    dense_detail::activate(layer.activation, output, batch, n_out);
+}
+
+/*!
+ * \brief Propagate a batch of samples through the complete network.
+ * \param input The samples, batch x input_size(), row-major
+ * \param output The activation probabilities of the last layer, batch x output_size()
+ */
+inline void dense_forward(const dense_network& network, const float* input, std::size_t batch, float* output, dense_workspace& workspace){
+    workspace.prepare(network, batch);
+
+    const float* current = input;
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        auto& layer = network.layers[l];
+
+        float* next = l + 1 == network.layers.size() ? output : (l % 2 == 0 ? workspace.a.data() : workspace.b.data());
+
+        dense_layer_forward(layer, current, batch, next);
+
+        current = next;
+    }
+}
+
+/*!
+ * \brief Copy samples [first, last) into a contiguous single-precision batch
+ */
+template<typename Images>
+void gather_batch(const Images& images, std::size_t first, std::size_t last, std::size_t sample_size, std::vector<float>& batch){
+    batch.resize((last - first) * sample_size);
+
+    for(std::size_t i = first; i < last; ++i){
+        auto& image = images[i];
+        std::copy(image.begin(), image.begin() + sample_size, batch.begin() + (i - first) * sample_size);
+    }
+}
+
+/*!
+ * \brief Return the index of the most probable class of a row
+ */
+inline std::size_t dense_argmax(const float* row, std::size_t outputs){
+    return std::max_element(row, row + outputs) - row;
+}
+
+#endif
@@ -0,0 +1,111 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file evaluation.hpp
+ * \brief Parallel batched evaluation of the DBNs of the experiments.
+ */
+
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "dll/test.hpp"
+
+#include "dbn_convert.hpp"
+#include "dense_network.hpp"
+#include "parallel.hpp"
+#include "quantized_network.hpp"
+
+constexpr const std::size_t evaluation_batch = 256;
+
+/*!
+ * \brief Compute the error rate of a dense network on a set of samples.
+ *
+ * The samples are stacked into batches which are propagated with
+ * matrix-matrix products, the batches being spread over all the cores.
+ */
+template<typename Images, typename Labels>
+double dense_test_set(const dense_network& network, const Images& images, const Labels& labels){
+    auto threads = default_threads();
+
+    std::vector<std::size_t> errors(threads, 0);
+
+    parallel_for_batches(images.size(), evaluation_batch, [&](std::size_t first, std::size_t last, std::size_t thread){
+        std::vector<float> input;
+        std::vector<float> output((last - first) * network.output_size());
+        dense_workspace workspace;
+
+        gather_batch(images, first, last, network.input_size(), input);
+        dense_forward(network, input.data(), last - first, output.data(), workspace);
+
+        for(std::size_t i = first; i < last; ++i){
+            if(dense_argmax(&output[(i - first) * network.output_size()], network.output_size()) != labels[i]){
+                ++errors[thread];
+            }
+        }
+    }, threads);
+
+    std::size_t total = 0;
+    for(auto e : errors){
+        total += e;
+    }
+
+    return images.empty() ? 0.0 : static_cast<double>(total) / images.size();
+}
+
+/*!
+ * \brief Compute the error rate of a DBN on a set of samples.
+ *
+ * With the default predictor and a DBN made only of dense RBMs, this
+ * uses the parallel batched engine. Otherwise, this falls back to
+ * dll::test_set.
+ */
+template<typename DBN, typename Images, typename Labels, typename P>
+double batch_test_set(DBN& dbn, const Images& images, const Labels& labels, P&& predictor){
+    if(std::is_same<std::decay_t<P>, dll::predictor>::value){
+        auto network = make_dense_network(*dbn);
+
+        if(!network.empty()){
+            return dense_test_set(network, images, labels);
+        }
+    }
+
+    return dll::test_set(dbn, images, labels, predictor);
+}
+
+/*!
+ * \brief Print the error rates of the DBN on the training and test sets,
+ * and of its quantized version when one is given.
+ */
+template<typename DBN, typename Dataset, typename P>
+void test_all(DBN& dbn, Dataset& dataset, P&& predictor, const quantized_network* quantized = nullptr){
+    std::cout << "Start testing" << std::endl;
+
+    std::cout << "Training Set" << std::endl;
+    auto error_rate = batch_test_set(dbn, dataset.training_images, dataset.training_labels, predictor);
+    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
+
+    if(quantized){
+        error_rate = quantized_test_set(*quantized, dataset.training_images, dataset.training_labels);
+        std::cout << "\tError rate (int8): " << 100.0 * error_rate << std::endl;
+    }
+
+    std::cout << "Test Set" << std::endl;
+    error_rate = batch_test_set(dbn, dataset.test_images, dataset.test_labels, predictor);
+    std::cout << "\tError rate (normal): " << 100.0 * error_rate << std::endl;
+
+    if(quantized){
+        error_rate = quantized_test_set(*quantized, dataset.test_images, dataset.test_labels);
+        std::cout << "\tError rate (int8): " << 100.0 * error_rate << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,97 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file feature_matrix.hpp
+ * \brief Contiguous row-major matrix of feature vectors.
+ */
+
+#ifndef FEATURE_MATRIX_HPP
+#define FEATURE_MATRIX_HPP
+
+#include <vector>
+
+#include "sample_view.hpp"
+
+/*!
+ * \brief A row-major matrix whose rows can be used as samples.
+ *
+ * The storage is allocated once for a maximum number of rows, so the
+ * row views stay valid while rows are appended.
+ */
+struct feature_matrix {
+    using value_type = sample_view<float>;
+    using iterator = std::vector<sample_view<float>>::const_iterator;
+    using const_iterator = std::vector<sample_view<float>>::const_iterator;
+
+    std::size_t columns = 0;
+    std::vector<float> data;
+    std::vector<sample_view<float>> rows;
+
+    feature_matrix() = default;
+
+    feature_matrix(std::size_t capacity, std::size_t columns){
+        reserve(capacity, columns);
+    }
+
+    feature_matrix(const feature_matrix&) = delete;
+    feature_matrix& operator=(const feature_matrix&) = delete;
+
+    feature_matrix(feature_matrix&&) = default;
+    feature_matrix& operator=(feature_matrix&&) = default;
+
+    /*!
+     * \brief Allocate the storage for capacity rows, the matrix being emptied
+     */
+    void reserve(std::size_t capacity, std::size_t columns){
+        this->columns = columns;
+        data.assign(capacity * columns, 0.0f);
+        rows.clear();
+        rows.reserve(capacity);
+    }
+
+    /*!
+     * \brief Allocate and zero n rows
+     */
+    void resize(std::size_t n, std::size_t columns){
+        reserve(n, columns);
+
+        for(std::size_t i = 0; i < n; ++i){
+            emplace_row();
+        }
+    }
+
+    /*!
+     * \brief Append a row and return a view of it
+     */
+    const sample_view<float>& emplace_row(){
+        rows.emplace_back(data.data() + rows.size() * columns, columns);
+        return rows.back();
+    }
+
+    std::size_t size() const {
+        return rows.size();
+    }
+
+    bool empty() const {
+        return rows.empty();
+    }
+
+    const sample_view<float>& operator[](std::size_t i) const {
+        return rows[i];
+    }
+
+    const_iterator begin() const {
+        return rows.begin();
+    }
+
+    const_iterator end() const {
+        return rows.end();
+    }
+};
+
+#endif
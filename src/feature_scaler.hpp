@@ -0,0 +1,198 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file feature_scaler.hpp
+ * \brief Per-column scaling of a feature matrix, fitted once and reusable.
+ */
+
+#ifndef FEATURE_SCALER_HPP
+#define FEATURE_SCALER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "feature_matrix.hpp"
+#include "parallel.hpp"
+
+/*!
+ * \brief The scaling method of a feature_scaler
+ */
+enum class scaling : uint32_t {
+    MIN_MAX  = 0, ///< Scale each column in [a, b]
+    STANDARD = 1  ///< Zero-mean and unit variance for each column
+};
+
+/*!
+ * \brief Affine per-column scaling, x' = x * scale + offset.
+ *
+ * The parameters are fitted on one matrix (the training set) and can be
+ * applied to others (the test set) or stored and loaded back.
+ */
+struct feature_scaler {
+    scaling method = scaling::MIN_MAX;
+    float a = 0.0f;
+    float b = 1.0f;
+
+    std::vector<float> scale;
+    std::vector<float> offset;
+
+    feature_scaler() = default;
+
+    explicit feature_scaler(scaling method, float a = 0.0f, float b = 1.0f) : method(method), a(a), b(b) {}
+
+    /*!
+     * \brief Compute the scaling parameters of each column in a single
+     * pass over the matrix, the rows being split between the threads.
+     */
+    void fit(const feature_matrix& features){
+        auto n = features.columns;
+        auto threads = default_threads();
+
+        //Min/max or sum/sum of squares, per thread and per column
+        std::vector<std::vector<double>> first(threads);
+        std::vector<std::vector<double>> second(threads);
+
+        for(std::size_t t = 0; t < threads; ++t){
+            if(method == scaling::MIN_MAX){
+                first[t].assign(n, std::numeric_limits<double>::max());
+                second[t].assign(n, std::numeric_limits<double>::lowest());
+            } else {
+                first[t].assign(n, 0.0);
+                second[t].assign(n, 0.0);
+            }
+        }
+
+        parallel_for_batches(features.size(), 1024, [&](std::size_t begin, std::size_t end, std::size_t t){
+            //Accumulate in float for a block of rows, which vectorizes, then merge in double
+            std::vector<float> f(n);
+            std::vector<float> s(n);
+
+            if(method == scaling::MIN_MAX){
+                std::fill(f.begin(), f.end(), std::numeric_limits<float>::max());
+                std::fill(s.begin(), s.end(), std::numeric_limits<float>::lowest());
+
+                for(std::size_t i = begin; i < end; ++i){
+                    auto row = features[i].data();
+                    for(std::size_t j = 0; j < n; ++j){
+                        f[j] = std::min(f[j], row[j]);
+                        s[j] = std::max(s[j], row[j]);
+                    }
+                }
+
+                for(std::size_t j = 0; j < n; ++j){
+                    first[t][j] = std::min(first[t][j], static_cast<double>(f[j]));
+                    second[t][j] = std::max(second[t][j], static_cast<double>(s[j]));
+                }
+            } else {
+                for(std::size_t i = begin; i < end; ++i){
+                    auto row = features[i].data();
+                    for(std::size_t j = 0; j < n; ++j){
+                        f[j] += row[j];
+                        s[j] += row[j] * row[j];
+                    }
+                }
+
+                for(std::size_t j = 0; j < n; ++j){
+                    first[t][j] += f[j];
+                    second[t][j] += s[j];
+                }
+            }
+        }, threads);
+
+        scale.assign(n, 1.0f);
+        offset.assign(n, 0.0f);
+
+        for(std::size_t j = 0; j < n; ++j){
+            double f = first[0][j];
+            double s = second[0][j];
+
+            for(std::size_t t = 1; t < threads; ++t){
+                if(method == scaling::MIN_MAX){
+                    f = std::min(f, first[t][j]);
+                    s = std::max(s, second[t][j]);
+                } else {
+                    f += first[t][j];
+                    s += second[t][j];
+                }
+            }
+
+            if(method == scaling::MIN_MAX){
+                auto range = s - f;
+                scale[j] = range > 0.0 ? (b - a) / range : 0.0;
+                offset[j] = range > 0.0 ? a - f * scale[j] : a;
+            } else {
+                auto mean = f / features.size();
+                auto stddev = std::sqrt(std::max(0.0, s / features.size() - mean * mean));
+                scale[j] = stddev > 0.0 ? 1.0 / stddev : 1.0;
+                offset[j] = -mean * scale[j];
+            }
+        }
+    }
+
+    /*!
+     * \brief Scale every row of the matrix in place, in parallel
+     */
+    void apply(feature_matrix& features) const {
+        auto n = features.columns;
+
+        parallel_for_batches(features.size(), 1024, [&](std::size_t begin, std::size_t end, std::size_t /*thread*/){
+            for(std::size_t i = begin; i < end; ++i){
+                auto row = features[i].data();
+                for(std::size_t j = 0; j < n; ++j){
+                    row[j] = row[j] * scale[j] + offset[j];
+                }
+            }
+        });
+    }
+
+    void store(std::ostream& os) const {
+        uint32_t header[2] = {static_cast<uint32_t>(method), static_cast<uint32_t>(scale.size())};
+
+        os.write(reinterpret_cast<const char*>(header), sizeof(header));
+        os.write(reinterpret_cast<const char*>(&a), sizeof(a));
+        os.write(reinterpret_cast<const char*>(&b), sizeof(b));
+        os.write(reinterpret_cast<const char*>(scale.data()), scale.size() * sizeof(float));
+        os.write(reinterpret_cast<const char*>(offset.data()), offset.size() * sizeof(float));
+    }
+
+    bool load(std::istream& is){
+        uint32_t header[2];
+
+        if(!is.read(reinterpret_cast<char*>(header), sizeof(header))){
+            return false;
+        }
+
+        method = static_cast<scaling>(header[0]);
+        scale.resize(header[1]);
+        offset.resize(header[1]);
+
+        is.read(reinterpret_cast<char*>(&a), sizeof(a));
+        is.read(reinterpret_cast<char*>(&b), sizeof(b));
+        is.read(reinterpret_cast<char*>(scale.data()), scale.size() * sizeof(float));
+        is.read(reinterpret_cast<char*>(offset.data()), offset.size() * sizeof(float));
+
+        return static_cast<bool>(is);
+    }
+
+    void store(const std::string& path) const {
+        std::ofstream os(path, std::ofstream::binary);
+        store(os);
+    }
+
+    bool load(const std::string& path){
+        std::ifstream is(path, std::ifstream::binary);
+        return load(is);
+    }
+};
+
+#endif
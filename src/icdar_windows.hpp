@@ -0,0 +1,98 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file icdar_windows.hpp
+ * \brief Lazy dataset of square windows centered on the pixels of ICDAR images.
+ */
+
+#ifndef ICDAR_WINDOWS_HPP
+#define ICDAR_WINDOWS_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "sample_view.hpp"
+
+/*!
+ * \brief Reference to the window centered on pixel (x, y) of an image
+ */
+struct window_ref {
+    uint32_t image;
+    uint32_t x;
+    uint32_t y;
+};
+
+/*!
+ * \brief A dataset of windows, each stored as an (image, x, y) reference.
+ *
+ * The pixels are only read when the windows are gathered, which makes
+ * it possible to enumerate, shuffle and select windows of large images
+ * without copying them.
+ */
+template<typename Images>
+struct window_dataset {
+    const Images* images;
+    std::size_t context;
+    std::vector<window_ref> windows;
+
+    window_dataset(const Images& images, std::size_t context) : images(&images), context(context) {}
+
+    std::size_t size() const {
+        return windows.size();
+    }
+
+    std::size_t dimension() const {
+        return 2 * context + 1;
+    }
+
+    std::size_t window_size() const {
+        return dimension() * dimension();
+    }
+
+    /*!
+     * \brief Copy the red channel of the given window, row by row, into out
+     */
+    void gather(const window_ref& window, float* out) const {
+        auto& image = (*images)[window.image];
+
+        auto d = dimension();
+
+        for(std::size_t row = 0; row < d; ++row){
+            auto y = window.y - context + row;
+            auto source = &image.pixels[y * image.width + window.x - context];
+
+            for(std::size_t col = 0; col < d; ++col){
+                out[row * d + col] = source[col].r;
+            }
+        }
+    }
+
+    /*!
+     * \brief Gather the windows [first, last) into a contiguous buffer
+     */
+    void gather(std::size_t first, std::size_t last, float* out) const {
+        for(std::size_t i = first; i < last; ++i){
+            gather(windows[i], out + (i - first) * window_size());
+        }
+    }
+
+    /*!
+     * \brief Gather all the windows into a batch that can be given to dll
+     */
+    sample_batch<float> gather_all() const {
+        sample_batch<float> batch;
+
+        batch.resize(size(), window_size());
+
+        gather(0, size(), batch.data.data());
+
+        return batch;
+    }
+};
+
+#endif
@@ -0,0 +1,182 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file jpeg_loader.hpp
+ * \brief Reduced-resolution JPEG decoding with the libjpeg DCT scaling.
+ */
+
+#ifndef JPEG_LOADER_HPP
+#define JPEG_LOADER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <jpeglib.h>
+
+/*!
+ * \brief A decoded image, 3 interleaved channels in BGR order (as OpenCV)
+ */
+struct jpeg_image {
+    std::size_t width = 0;
+    std::size_t height = 0;
+    std::size_t full_width = 0;  ///< The width of the image before the DCT scaling
+    std::size_t full_height = 0; ///< The height of the image before the DCT scaling
+    std::vector<uint8_t> data;
+};
+
+namespace jpeg_detail {
+
+struct error_manager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+};
+
+inline void error_exit(j_common_ptr info){
+    std::longjmp(reinterpret_cast<error_manager*>(info->err)->jump, 1);
+}
+
+inline void output_message(j_common_ptr /*info*/){
+    //Warnings of corrupt data are not printed
+}
+
+/*!
+ * \brief Return the largest libjpeg scale denominator (8, 4, 2 or 1)
+ * for which the largest dimension stays at least max_size.
+ */
+inline unsigned int scale_denom(std::size_t width, std::size_t height, std::size_t max_size){
+    auto size = std::max(width, height);
+
+    for(unsigned int denom : {8u, 4u, 2u}){
+        if((size + denom - 1) / denom >= max_size){
+            return denom;
+        }
+    }
+
+    return 1;
+}
+
+//The decoding part, with only trivially destructible locals, between setjmp and longjmp
+inline bool decode(jpeg_decompress_struct& info, error_manager& error, std::FILE* file, std::size_t max_size, jpeg_image& image, std::vector<uint8_t>& row){
+    if(setjmp(error.jump)){
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+
+    if(jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK){
+        return false;
+    }
+
+    bool gray = info.jpeg_color_space == JCS_GRAYSCALE;
+
+    if(gray){
+        info.out_color_space = JCS_GRAYSCALE;
+    } else if(info.jpeg_color_space == JCS_YCbCr || info.jpeg_color_space == JCS_RGB){
+        info.out_color_space = JCS_RGB;
+    } else {
+        //CMYK and others are left to the full decoders
+        return false;
+    }
+
+    info.scale_num = 1;
+    info.scale_denom = max_size ? scale_denom(info.image_width, info.image_height, max_size) : 1;
+
+    jpeg_start_decompress(&info);
+
+    image.width = info.output_width;
+    image.height = info.output_height;
+    image.full_width = info.image_width;
+    image.full_height = info.image_height;
+    image.data.resize(image.width * image.height * 3);
+    row.resize(image.width * info.output_components);
+
+    while(info.output_scanline < info.output_height){
+        auto y = info.output_scanline;
+        JSAMPROW rows[1] = {row.data()};
+
+        jpeg_read_scanlines(&info, rows, 1);
+
+        auto out = &image.data[y * image.width * 3];
+
+        for(std::size_t x = 0; x < image.width; ++x){
+            if(gray){
+                out[3 * x] = out[3 * x + 1] = out[3 * x + 2] = row[x];
+            } else {
+                out[3 * x] = row[3 * x + 2];
+                out[3 * x + 1] = row[3 * x + 1];
+                out[3 * x + 2] = row[3 * x];
+            }
+        }
+    }
+
+    jpeg_finish_decompress(&info);
+
+    return true;
+}
+
+} //end of namespace jpeg_detail
+
+/*!
+ * \brief Decode a JPEG file at the smallest DCT scale (1/8, 1/4, 1/2 or
+ * 1) whose largest dimension is still at least max_size.
+ *
+ * Only the final (small) reduction to max_size remains to be done by
+ * the caller. With max_size = 0, the image is decoded at full size.
+ *
+ * \return false if the file cannot be decoded, in which case a full
+ * decoder should be used.
+ */
+inline bool read_jpeg_scaled(const std::string& path, std::size_t max_size, jpeg_image& image){
+    auto file = std::fopen(path.c_str(), "rb");
+
+    if(!file){
+        return false;
+    }
+
+    jpeg_decompress_struct info;
+    jpeg_detail::error_manager error;
+    std::vector<uint8_t> row;
+
+    info.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = jpeg_detail::error_exit;
+    error.pub.output_message = jpeg_detail::output_message;
+
+    auto result = jpeg_detail::decode(info, error, file, max_size, image, row);
+
+    jpeg_destroy_decompress(&info);
+    std::fclose(file);
+
+    return result;
+}
+
+/*!
+ * \brief Indicates if the path has a JPEG extension
+ */
+inline bool is_jpeg_path(const std::string& path){
+    auto dot = path.rfind('.');
+
+    if(dot == std::string::npos){
+        return false;
+    }
+
+    auto extension = path.substr(dot + 1);
+
+    for(auto& c : extension){
+        c = std::tolower(c);
+    }
+
+    return extension == "jpg" || extension == "jpeg";
+}
+
+#endif
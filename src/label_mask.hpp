@@ -0,0 +1,150 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file label_mask.hpp
+ * \brief Rasterized text masks of the ICDAR labels.
+ */
+
+#ifndef LABEL_MASK_HPP
+#define LABEL_MASK_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief Bit mask of the text pixels of one image, one bit per pixel.
+ *
+ * An integral image of the mask can be computed on demand to count the
+ * text pixels of any rectangle in constant time.
+ */
+struct label_mask {
+    std::size_t width = 0;
+    std::size_t height = 0;
+    std::size_t words_per_row = 0;
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> integral; ///< (width + 1) x (height + 1), empty until compute_integral()
+
+    label_mask() = default;
+
+    label_mask(std::size_t width, std::size_t height) : width(width), height(height), words_per_row((width + 63) / 64), bits(words_per_row * height, 0) {}
+
+    bool text(std::size_t x, std::size_t y) const {
+        return (bits[y * words_per_row + x / 64] >> (x % 64)) & 1;
+    }
+
+    const uint64_t* row(std::size_t y) const {
+        return &bits[y * words_per_row];
+    }
+
+    /*!
+     * \brief Mark [left, right] x [top, bottom] (inclusive) as text
+     */
+    void fill(std::size_t left, std::size_t top, std::size_t right, std::size_t bottom){
+        if(left >= width || top >= height || right < left || bottom < top){
+            return;
+        }
+
+        right = std::min(right, width - 1);
+        bottom = std::min(bottom, height - 1);
+
+        auto first_word = left / 64;
+        auto last_word = right / 64;
+
+        auto first_mask = ~uint64_t(0) << (left % 64);
+        auto last_mask = ~uint64_t(0) >> (63 - right % 64);
+
+        for(std::size_t y = top; y <= bottom; ++y){
+            auto r = &bits[y * words_per_row];
+
+            if(first_word == last_word){
+                r[first_word] |= first_mask & last_mask;
+            } else {
+                r[first_word] |= first_mask;
+                std::fill(r + first_word + 1, r + last_word, ~uint64_t(0));
+                r[last_word] |= last_mask;
+            }
+        }
+
+        integral.clear();
+    }
+
+    /*!
+     * \brief Number of text pixels in the image
+     */
+    std::size_t count() const {
+        std::size_t count = 0;
+        for(auto word : bits){
+            count += __builtin_popcountll(word);
+        }
+        return count;
+    }
+
+    void compute_integral(){
+        integral.assign((width + 1) * (height + 1), 0);
+
+        for(std::size_t y = 0; y < height; ++y){
+            uint32_t row_sum = 0;
+
+            for(std::size_t x = 0; x < width; ++x){
+                row_sum += text(x, y);
+                integral[(y + 1) * (width + 1) + x + 1] = integral[y * (width + 1) + x + 1] + row_sum;
+            }
+        }
+    }
+
+    /*!
+     * \brief Number of text pixels in [x0, x1) x [y0, y1).
+     *
+     * compute_integral() must have been called.
+     */
+    std::size_t count(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1) const {
+        auto w = width + 1;
+        return integral[y1 * w + x1] + integral[y0 * w + x0] - integral[y0 * w + x1] - integral[y1 * w + x0];
+    }
+
+    /*!
+     * \brief Fraction of text pixels in [x0, x1) x [y0, y1).
+     *
+     * compute_integral() must have been called.
+     */
+    double text_fraction(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1) const {
+        return static_cast<double>(count(x0, y0, x1, y1)) / ((x1 - x0) * (y1 - y0));
+    }
+};
+
+/*!
+ * \brief Rasterize the rectangles of a label
+ */
+template<typename Label>
+label_mask make_label_mask(const Label& label, std::size_t width, std::size_t height){
+    label_mask mask(width, height);
+
+    for(auto& rectangle : label.rectangles){
+        mask.fill(rectangle.left, rectangle.top, rectangle.right, rectangle.bottom);
+    }
+
+    return mask;
+}
+
+/*!
+ * \brief Rasterize the labels of a set of images, mask i corresponding to image i
+ */
+template<typename Images, typename Labels>
+std::vector<label_mask> make_label_masks(const Images& images, const Labels& labels){
+    std::vector<label_mask> masks;
+    masks.reserve(images.size());
+
+    for(std::size_t i = 0; i < images.size(); ++i){
+        masks.push_back(make_label_mask(labels[i], images[i].width, images[i].height));
+    }
+
+    return masks;
+}
+
+#endif
@@ -0,0 +1,155 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file location_sampler.hpp
+ * \brief Class-balanced sampling of pixel locations from label masks.
+ */
+
+#ifndef LOCATION_SAMPLER_HPP
+#define LOCATION_SAMPLER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "label_mask.hpp"
+
+/*!
+ * \brief A sampled pixel and its label (1 for text)
+ */
+struct pixel_location {
+    uint32_t image;
+    uint32_t x;
+    uint32_t y;
+    uint32_t label;
+};
+
+/*!
+ * \brief Draw count distinct integers from [0, population), sorted.
+ *
+ * This uses Floyd's algorithm, whose memory is proportional to count.
+ */
+template<typename RNG>
+std::vector<std::size_t> sample_ranks(std::size_t population, std::size_t count, RNG& g){
+    count = std::min(count, population);
+
+    std::unordered_set<std::size_t> selected;
+    selected.reserve(count);
+
+    for(std::size_t j = population - count; j < population; ++j){
+        std::uniform_int_distribution<std::size_t> dist(0, j);
+        auto t = dist(g);
+
+        if(!selected.insert(t).second){
+            selected.insert(j);
+        }
+    }
+
+    std::vector<std::size_t> ranks(selected.begin(), selected.end());
+    std::sort(ranks.begin(), ranks.end());
+    return ranks;
+}
+
+namespace location_detail {
+
+inline std::size_t class_count(const label_mask& mask, bool text){
+    auto count = mask.count();
+    return text ? count : mask.width * mask.height - count;
+}
+
+//Position of the k-th set bit of word
+inline std::size_t select_bit(uint64_t word, std::size_t k){
+    for(std::size_t i = 0; i < k; ++i){
+        word &= word - 1;
+    }
+
+    return __builtin_ctzll(word);
+}
+
+/*!
+ * \brief Find the pixels of the given class with the given (sorted)
+ * ranks, the pixels being numbered image by image, row by row.
+ */
+inline void select_pixels(const std::vector<label_mask>& masks, bool text, const std::vector<std::size_t>& ranks, std::vector<pixel_location>& locations){
+    auto r = ranks.begin();
+
+    std::size_t base = 0;
+
+    for(std::size_t i = 0; i < masks.size() && r != ranks.end(); ++i){
+        auto& mask = masks[i];
+        auto count = class_count(mask, text);
+
+        if(*r < base + count){
+            std::size_t seen = base;
+
+            for(std::size_t y = 0; y < mask.height && r != ranks.end(); ++y){
+                auto row = mask.row(y);
+
+                for(std::size_t w = 0; w < mask.words_per_row; ++w){
+                    auto word = row[w];
+
+                    if(!text){
+                        auto valid = mask.width - w * 64;
+                        word = ~word & (valid >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid) - 1);
+                    }
+
+                    std::size_t bits = __builtin_popcountll(word);
+
+                    while(r != ranks.end() && *r < seen + bits){
+                        auto x = w * 64 + select_bit(word, *r - seen);
+                        locations.push_back({static_cast<uint32_t>(i), static_cast<uint32_t>(x), static_cast<uint32_t>(y), text ? 1u : 0u});
+                        ++r;
+                    }
+
+                    seen += bits;
+                }
+            }
+        }
+
+        base += count;
+    }
+}
+
+} //end of namespace location_detail
+
+/*!
+ * \brief Draw limit pixel locations, half of them text and half of them
+ * background, uniformly within each class.
+ *
+ * If one class does not have enough pixels, the other class fills the
+ * remaining slots. Only the sampled locations are stored, the memory
+ * does not depend on the number of pixels.
+ */
+template<typename RNG>
+std::vector<pixel_location> sample_balanced_locations(const std::vector<label_mask>& masks, std::size_t limit, RNG& g){
+    std::size_t total_text = 0;
+    std::size_t total_background = 0;
+
+    for(auto& mask : masks){
+        total_text += location_detail::class_count(mask, true);
+        total_background += location_detail::class_count(mask, false);
+    }
+
+    auto n_text = std::min(total_text, limit / 2);
+    auto n_background = std::min(total_background, limit - n_text);
+    n_text = std::min(total_text, limit - n_background);
+
+    std::vector<pixel_location> locations;
+    locations.reserve(n_text + n_background);
+
+    location_detail::select_pixels(masks, true, sample_ranks(total_text, n_text, g), locations);
+    location_detail::select_pixels(masks, false, sample_ranks(total_background, n_background, g), locations);
+
+    std::shuffle(locations.begin(), locations.end(), g);
+
+    return locations;
+}
+
+#endif
@@ -0,0 +1,377 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file mnist_cache.hpp
+ * \brief Memory-mapped cache of pre-processed MNIST datasets.
+ *
+ * The first run reads the IDX files, applies the requested
+ * pre-processing once and dumps the result as a single page-aligned
+ * block. Every following run only maps the file: the samples are
+ * exposed as views into the mapping and the pages are shared between
+ * all the processes using the same cache.
+ */
+
+#ifndef MNIST_CACHE_HPP
+#define MNIST_CACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mnist/mnist_reader.hpp"
+#include "mnist/mnist_utils.hpp"
+
+#include "sample_view.hpp"
+
+/*!
+ * \brief The pre-processing stored in a cache
+ */
+enum class cache_mode : uint32_t {
+    RAW        = 0, ///< The pixels as read from the IDX files
+    BINARIZE   = 1, ///< mnist::binarize_dataset
+    NORMALIZE  = 2  ///< mnist::normalize_dataset
+};
+
+/*!
+ * \brief A read-only mapping of a complete file
+ */
+struct mapped_file {
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    mapped_file() = default;
+
+    explicit mapped_file(const std::string& path){
+        auto fd = ::open(path.c_str(), O_RDONLY);
+
+        if(fd < 0){
+            return;
+        }
+
+        struct stat st;
+        if(::fstat(fd, &st) == 0 && st.st_size > 0){
+            auto address = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+            if(address != MAP_FAILED){
+                data = static_cast<const char*>(address);
+                size = st.st_size;
+
+                ::madvise(address, size, MADV_WILLNEED);
+            }
+        }
+
+        ::close(fd);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file(){
+        if(data){
+            ::munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    bool valid() const {
+        return data != nullptr;
+    }
+};
+
+/*!
+ * \brief A MNIST dataset whose images are views into a cache mapping.
+ *
+ * The members have the same names as mnist::MNIST_dataset so that the
+ * experiments can use both interchangeably.
+ */
+template<typename T>
+struct cached_dataset {
+    std::vector<sample_view<const T>> training_images;
+    std::vector<sample_view<const T>> test_images;
+    std::vector<uint8_t> training_labels;
+    std::vector<uint8_t> test_labels;
+
+    std::shared_ptr<mapped_file> mapping;
+};
+
+namespace cache_detail {
+
+constexpr const char magic[8] = {'M', 'N', 'C', 'A', 'C', 'H', 'E', '1'};
+constexpr const uint32_t version = 2;
+constexpr const std::size_t page_size = 4096;
+
+//The IDX files read by mnist::read_dataset_direct
+constexpr const char* sources[4] = {
+    "mnist/train-images-idx3-ubyte",
+    "mnist/train-labels-idx1-ubyte",
+    "mnist/t10k-images-idx3-ubyte",
+    "mnist/t10k-labels-idx1-ubyte"
+};
+
+/*!
+ * \brief Size and modification time of a source IDX file, zero if the
+ * file does not exist
+ */
+struct source_stamp {
+    uint64_t size;
+    int64_t mtime_ns;
+};
+
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t mode;
+    uint32_t value_size;
+    uint32_t sample_size;
+    uint64_t training_count;
+    uint64_t test_count;
+    uint64_t images_offset;
+    uint64_t labels_offset;
+    uint64_t padding;
+    source_stamp stamps[4]; ///< The IDX files the cache was built from
+};
+
+static_assert(sizeof(header) == 128, "The cache header must be 128 bytes");
+
+inline void stamp_sources(source_stamp (&stamps)[4]){
+    for(std::size_t i = 0; i < 4; ++i){
+        struct stat st;
+
+        if(::stat(sources[i], &st) == 0){
+            stamps[i].size = st.st_size;
+            stamps[i].mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        } else {
+            stamps[i].size = 0;
+            stamps[i].mtime_ns = 0;
+        }
+    }
+}
+
+/*!
+ * \brief Indicates if the IDX files changed since the cache was built.
+ *
+ * When none of the IDX files is present, the cache cannot be rebuilt
+ * and is used as is.
+ */
+inline bool sources_changed(const header& h){
+    source_stamp stamps[4];
+    stamp_sources(stamps);
+
+    auto missing = true;
+    auto changed = false;
+
+    for(std::size_t i = 0; i < 4; ++i){
+        missing = missing && stamps[i].size == 0 && stamps[i].mtime_ns == 0;
+        changed = changed || stamps[i].size != h.stamps[i].size || stamps[i].mtime_ns != h.stamps[i].mtime_ns;
+    }
+
+    return changed && !missing;
+}
+
+inline std::size_t align_up(std::size_t value, std::size_t alignment){
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline std::string cache_path(cache_mode mode, std::size_t value_size, std::size_t limit){
+    std::string directory = ".";
+
+    if(auto env = std::getenv("MNIST_CACHE_DIR")){
+        directory = env;
+    }
+
+    std::string mode_name = mode == cache_mode::BINARIZE ? "binarized" : mode == cache_mode::NORMALIZE ? "normalized" : "raw";
+
+    return directory + "/mnist-" + mode_name + "-f" + std::to_string(8 * value_size) + "-" + std::to_string(limit) + ".cache";
+}
+
+inline bool check_header(const mapped_file& file, cache_mode mode, std::size_t value_size){
+    if(!file.valid() || file.size < sizeof(header)){
+        return false;
+    }
+
+    auto& h = *reinterpret_cast<const header*>(file.data);
+
+    if(std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version){
+        return false;
+    }
+
+    if(h.mode != static_cast<uint32_t>(mode) || h.value_size != value_size || sources_changed(h)){
+        return false;
+    }
+
+    auto samples = h.training_count + h.test_count;
+
+    return h.images_offset % page_size == 0
+        && h.images_offset + samples * h.sample_size * value_size <= h.labels_offset
+        && h.labels_offset + samples <= file.size;
+}
+
+template<typename T>
+bool write_cache(const std::string& path, cache_mode mode, std::size_t limit){
+    //Stamped before the read, a file modified during the read makes the next run rebuild the cache
+    source_stamp stamps[4];
+    stamp_sources(stamps);
+
+    auto dataset = mnist::read_dataset_direct<std::vector, std::vector<T>>(limit);
+
+    if(dataset.training_images.empty() || dataset.training_labels.empty()){
+        return false;
+    }
+
+    if(mode == cache_mode::BINARIZE){
+        mnist::binarize_dataset(dataset);
+    } else if(mode == cache_mode::NORMALIZE){
+        mnist::normalize_dataset(dataset);
+    }
+
+    header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.mode = static_cast<uint32_t>(mode);
+    h.value_size = sizeof(T);
+    h.sample_size = dataset.training_images[0].size();
+    h.training_count = dataset.training_images.size();
+    h.test_count = dataset.test_images.size();
+    h.images_offset = page_size;
+    h.labels_offset = align_up(h.images_offset + (h.training_count + h.test_count) * h.sample_size * sizeof(T), page_size);
+    std::memcpy(h.stamps, stamps, sizeof(stamps));
+
+    //Write to a private file and rename it so that concurrent jobs never see a partial cache
+    auto tmp_path = path + ".tmp." + std::to_string(::getpid());
+
+    {
+        std::ofstream os(tmp_path, std::ofstream::binary);
+
+        std::vector<char> zeroes(page_size, 0);
+
+        os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        os.write(zeroes.data(), h.images_offset - sizeof(h));
+
+        for(auto* images : {&dataset.training_images, &dataset.test_images}){
+            for(auto& image : *images){
+                os.write(reinterpret_cast<const char*>(image.data()), h.sample_size * sizeof(T));
+            }
+        }
+
+        os.write(zeroes.data(), h.labels_offset - (h.images_offset + (h.training_count + h.test_count) * h.sample_size * sizeof(T)));
+
+        os.write(reinterpret_cast<const char*>(dataset.training_labels.data()), h.training_count);
+        os.write(reinterpret_cast<const char*>(dataset.test_labels.data()), h.test_count);
+
+        if(!os){
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+} //end of namespace cache_detail
+
+/*!
+ * \brief Read the MNIST dataset through the cache, building the cache if necessary.
+ * \param limit The maximum number of training images (0 for all)
+ * \param mode The pre-processing to apply to the images
+ * \return The dataset, empty if neither the cache nor the IDX files could be read
+ */
+template<typename T>
+cached_dataset<T> read_cached_dataset(std::size_t limit, cache_mode mode){
+    using cache_detail::header;
+
+    cached_dataset<T> dataset;
+
+    auto path = cache_detail::cache_path(mode, sizeof(T), limit);
+    auto file = std::make_shared<mapped_file>(path);
+
+    if(!cache_detail::check_header(*file, mode, sizeof(T))){
+        std::cout << "Build MNIST cache " << path << std::endl;
+
+        if(!cache_detail::write_cache<T>(path, mode, limit)){
+            std::cout << "Impossible to build the MNIST cache" << std::endl;
+            return dataset;
+        }
+
+        file = std::make_shared<mapped_file>(path);
+
+        if(!cache_detail::check_header(*file, mode, sizeof(T))){
+            return dataset;
+        }
+    }
+
+    auto& h = *reinterpret_cast<const header*>(file->data);
+
+    auto images = reinterpret_cast<const T*>(file->data + h.images_offset);
+    auto labels = reinterpret_cast<const uint8_t*>(file->data + h.labels_offset);
+
+    dataset.training_images.reserve(h.training_count);
+    dataset.test_images.reserve(h.test_count);
+
+    for(std::size_t i = 0; i < h.training_count; ++i){
+        dataset.training_images.emplace_back(images + i * h.sample_size, h.sample_size);
+    }
+
+    for(std::size_t i = 0; i < h.test_count; ++i){
+        dataset.test_images.emplace_back(images + (h.training_count + i) * h.sample_size, h.sample_size);
+    }
+
+    dataset.training_labels.assign(labels, labels + h.training_count);
+    dataset.test_labels.assign(labels + h.training_count, labels + h.training_count + h.test_count);
+
+    dataset.mapping = std::move(file);
+
+    return dataset;
+}
+
+/*!
+ * \brief Read the MNIST dataset through the cache into owning containers.
+ *
+ * This is for the experiments that need a specific sample type (for
+ * instance the 3D matrices of the convolutional DBNs). The samples are
+ * copied once from the mapping, but the IDX parsing and the
+ * pre-processing passes are still avoided. Image must be default
+ * constructible with the size of one sample.
+ */
+template<template<typename...> class Container, typename Image>
+mnist::MNIST_dataset<Container, Image, uint8_t> read_cached_dataset_direct(std::size_t limit, cache_mode mode){
+    using value_t = typename Image::value_type;
+
+    mnist::MNIST_dataset<Container, Image, uint8_t> dataset;
+
+    auto cached = read_cached_dataset<value_t>(limit, mode);
+
+    auto copy = [](const std::vector<sample_view<const value_t>>& views, Container<Image>& images){
+        images.reserve(views.size());
+
+        for(auto& view : views){
+            images.emplace_back();
+            std::copy(view.begin(), view.end(), images.back().begin());
+        }
+    };
+
+    copy(cached.training_images, dataset.training_images);
+    copy(cached.test_images, dataset.test_images);
+
+    dataset.training_labels.assign(cached.training_labels.begin(), cached.training_labels.end());
+    dataset.test_labels.assign(cached.test_labels.begin(), cached.test_labels.end());
+
+    return dataset;
+}
+
+#endif
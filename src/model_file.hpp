@@ -0,0 +1,717 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file model_file.hpp
+ * \brief Self-describing model files that can be mapped in memory.
+ *
+ * A model file starts with a header giving the kind of the network
+ * (dense or convolutional), the precision of the weights and the
+ * number of layers, followed by one record per layer (sizes, hidden and
+ * visible activations and position of its weights). The weights, the
+ * hidden biases and the visible biases of each layer are stored in
+ * single precision in a block aligned on a page, so that the file can
+ * be mapped and the layers used in place, without reading nor copying
+ * them. The visible units are not needed for inference, but they are
+ * needed to restore the RBMs.
+ *
+ * Layout, all integers little-endian:
+ *
+ *     file_header     (32 bytes)
+ *     layer_record    (80 bytes) x layers
+ *     padding up to the next page
+ *     weights, biases, visible biases of layer 0 (float), padding up to the next page
+ *     ...
+ *
+ * The int8 model files (precision INT8, dense networks only) hold a
+ * quantized_network. The block of each layer contains its quantization
+ * parameters (quantized_params), then its biases (float), the sums of
+ * the rows of its weights (int32) and its transposed weights (int8).
+ * These files are read into memory, the layers owning their weights.
+ */
+
+#ifndef MODEL_FILE_HPP
+#define MODEL_FILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "conv_network.hpp"
+#include "dbn_convert.hpp"
+#include "dense_network.hpp"
+#include "quantized_network.hpp"
+
+namespace model_file_detail {
+
+constexpr const char magic[8] = {'D', 'B', 'N', 'M', 'O', 'D', 'E', 'L'};
+constexpr const uint32_t version = 2;
+constexpr const uint64_t alignment = 4096;
+
+enum class network_kind : uint32_t {
+    DENSE = 0,
+    CONV  = 1
+};
+
+enum class precision : uint32_t {
+    FLOAT32 = 0,
+    INT8    = 1
+};
+
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    network_kind kind;
+    precision weights;
+    uint32_t layers;
+    uint64_t alignment; ///< Alignment of the weight blocks, in bytes
+};
+
+/*!
+ * \brief The description of one layer.
+ *
+ * dims is {inputs, outputs, 0, 0} for a dense layer and {nc, nv, k, nh}
+ * for a convolutional layer.
+ */
+struct layer_record {
+    dense_activation activation;
+    dense_activation visible;  ///< Activation of the visible units
+    uint64_t dims[4];
+    uint64_t offset;           ///< Offset of the weights from the start of the file, in bytes
+    uint64_t weights;          ///< Number of weights
+    uint64_t biases;           ///< Number of biases, following the weights
+    uint64_t visible_biases;   ///< Number of visible biases, following the biases
+    uint64_t reserved;
+};
+
+/*!
+ * \brief The quantization parameters of a layer, at the start of its
+ * block in an int8 model file
+ */
+struct quantized_params {
+    float weight_scale;
+    float input_scale;
+    int32_t input_zero;
+    uint32_t padding;
+};
+
+static_assert(sizeof(file_header) == 32, "The model file header must be packed");
+static_assert(sizeof(layer_record) == 80, "The model layer record must be packed");
+static_assert(sizeof(quantized_params) == 16, "The quantization parameters must be packed");
+
+inline uint64_t align(uint64_t offset){
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+inline network_kind kind_of(const dense_network& /*network*/){
+    return network_kind::DENSE;
+}
+
+inline network_kind kind_of(const conv_network& /*network*/){
+    return network_kind::CONV;
+}
+
+inline network_kind kind_of(const quantized_network& /*network*/){
+    return network_kind::DENSE;
+}
+
+inline layer_record describe(const dense_layer& layer){
+    layer_record record{};
+    record.activation = layer.activation;
+    record.visible = layer.visible;
+    record.dims[0] = layer.inputs;
+    record.dims[1] = layer.outputs;
+    record.weights = layer.inputs * layer.outputs;
+    record.biases = layer.outputs;
+    record.visible_biases = layer.inputs;
+    return record;
+}
+
+inline layer_record describe(const conv_layer& layer){
+    layer_record record{};
+    record.activation = layer.activation;
+    record.visible = layer.visible;
+    record.dims[0] = layer.nc;
+    record.dims[1] = layer.nv;
+    record.dims[2] = layer.k;
+    record.dims[3] = layer.nh;
+    record.weights = layer.nc * layer.k * layer.nw() * layer.nw();
+    record.biases = layer.k;
+    record.visible_biases = layer.nc;
+    return record;
+}
+
+inline layer_record describe(const quantized_layer& layer){
+    layer_record record{};
+    record.activation = layer.activation;
+    record.visible = layer.visible;
+    record.dims[0] = layer.inputs;
+    record.dims[1] = layer.outputs;
+    record.weights = layer.inputs * layer.outputs;
+    record.biases = layer.outputs;
+    record.visible_biases = 0;
+    return record;
+}
+
+//Size of the block of a layer of an int8 model file
+inline uint64_t quantized_block(const layer_record& record){
+    return sizeof(quantized_params) + record.biases * (sizeof(float) + sizeof(int32_t)) + record.weights;
+}
+
+inline void bind(const layer_record& record, const float* weights, dense_layer& layer){
+    layer.inputs = record.dims[0];
+    layer.outputs = record.dims[1];
+    layer.activation = record.activation;
+    layer.visible = record.visible;
+    layer.weights = weights;
+    layer.biases = weights + record.weights;
+    layer.visible_biases = layer.biases + record.biases;
+}
+
+inline void bind(const layer_record& record, const float* weights, conv_layer& layer){
+    layer.nc = record.dims[0];
+    layer.nv = record.dims[1];
+    layer.k = record.dims[2];
+    layer.nh = record.dims[3];
+    layer.activation = record.activation;
+    layer.visible = record.visible;
+    layer.weights = weights;
+    layer.biases = weights + record.weights;
+    layer.visible_biases = layer.biases + record.biases;
+}
+
+//The sizes of a record must be consistent, or the layer would read outside of its block
+
+inline bool consistent(const layer_record& record, network_kind kind, precision weights){
+    if(weights == precision::INT8){
+        return kind == network_kind::DENSE && record.weights == record.dims[0] * record.dims[1] && record.biases == record.dims[1] && record.visible_biases == 0;
+    }
+
+    if(kind == network_kind::DENSE){
+        return record.weights == record.dims[0] * record.dims[1] && record.biases == record.dims[1] && record.visible_biases == record.dims[0];
+    }
+
+    auto nv = record.dims[1];
+    auto nh = record.dims[3];
+
+    return nh && nh <= nv && record.weights == record.dims[0] * record.dims[2] * (nv - nh + 1) * (nv - nh + 1)
+        && record.biases == record.dims[2] && record.visible_biases == record.dims[0];
+}
+
+inline bool same_shape(const layer_record& lhs, const layer_record& rhs){
+    return lhs.activation == rhs.activation && lhs.visible == rhs.visible && std::equal(lhs.dims, lhs.dims + 4, rhs.dims);
+}
+
+inline const char* activation_name(dense_activation activation){
+    switch(activation){
+        case dense_activation::SIGMOID:
+            return "sigmoid";
+        case dense_activation::SOFTMAX:
+            return "softmax";
+        case dense_activation::RELU:
+            return "relu";
+        case dense_activation::IDENTITY:
+            return "identity";
+    }
+
+    return "unknown";
+}
+
+inline std::ostream& operator<<(std::ostream& os, const layer_record& record){
+    os << record.dims[0];
+    for(std::size_t d = 1; d < 4 && record.dims[d]; ++d){
+        os << "x" << record.dims[d];
+    }
+    return os << " (visible " << activation_name(record.visible) << ", hidden " << activation_name(record.activation) << ")";
+}
+
+/*!
+ * \brief A read-only mapping of a whole file
+ */
+struct mapped_file {
+    void* data = MAP_FAILED;
+    std::size_t size = 0;
+
+    explicit mapped_file(const std::string& path){
+        auto fd = ::open(path.c_str(), O_RDONLY);
+
+        if(fd < 0){
+            return;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0){
+            size = st.st_size;
+            data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+
+        ::close(fd);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file(){
+        if(data != MAP_FAILED){
+            munmap(data, size);
+        }
+    }
+
+    bool valid() const {
+        return data != MAP_FAILED;
+    }
+
+    const char* bytes() const {
+        return static_cast<const char*>(data);
+    }
+};
+
+//Copy the weights and the biases of a flat layer back into the RBM
+
+template<typename RBM>
+void restore_layer(RBM& rbm, const dense_layer& layer, std::true_type){
+    for(std::size_t i = 0; i < RBM::num_visible; ++i){
+        for(std::size_t j = 0; j < RBM::num_hidden; ++j){
+            rbm.w(i, j) = layer.weights[i * RBM::num_hidden + j];
+        }
+    }
+
+    for(std::size_t j = 0; j < RBM::num_hidden; ++j){
+        rbm.b(j) = layer.biases[j];
+    }
+
+    for(std::size_t i = 0; i < RBM::num_visible; ++i){
+        rbm.c(i) = layer.visible_biases[i];
+    }
+}
+
+template<typename RBM>
+void restore_layer(RBM& rbm, const conv_layer& layer, std::true_type){
+    auto nw = layer.nw();
+    auto w = layer.weights;
+
+    for(std::size_t c = 0; c < RBM::NC; ++c){
+        for(std::size_t k = 0; k < RBM::K; ++k){
+            for(std::size_t a = 0; a < nw; ++a){
+                for(std::size_t b = 0; b < nw; ++b){
+                    rbm.w(c, k, a, b) = *w++;
+                }
+            }
+        }
+    }
+
+    for(std::size_t k = 0; k < RBM::K; ++k){
+        rbm.b(k) = layer.biases[k];
+    }
+
+    for(std::size_t c = 0; c < RBM::NC; ++c){
+        rbm.c(c) = layer.visible_biases[c];
+    }
+}
+
+template<typename RBM, typename Layer>
+void restore_layer(RBM& /*rbm*/, const Layer& /*layer*/, std::false_type){}
+
+template<typename DBN, typename Network>
+void restore_layers(DBN& /*dbn*/, const Network& /*network*/, std::integral_constant<std::size_t, DBN::layers>){}
+
+template<typename DBN, typename Network, std::size_t I, std::enable_if_t<(I < DBN::layers), int> = 0>
+void restore_layers(DBN& dbn, const Network& network, std::integral_constant<std::size_t, I>){
+    auto& rbm = convert_detail::get_layer<I>(dbn, 0);
+
+    using rbm_t = std::decay_t<decltype(rbm)>;
+    using layer_t = typename decltype(network.layers)::value_type;
+
+    restore_layer(rbm, network.layers[I], convert_detail::is_layer_of<rbm_t, layer_t>());
+    restore_layers(dbn, network, std::integral_constant<std::size_t, I + 1>());
+}
+
+/*!
+ * \brief Check the header of a model file, which must contain a network
+ * of the given kind and precision.
+ * \return The layer records, nullptr if the file is not valid
+ */
+inline const layer_record* read_header(const mapped_file& file, const std::string& path, network_kind kind, precision weights, file_header& header){
+    if(!file.valid()){
+        std::cerr << "Impossible to map the model file " << path << std::endl;
+        return nullptr;
+    }
+
+    if(file.size < sizeof(header)){
+        std::cerr << path << " is not a model file" << std::endl;
+        return nullptr;
+    }
+
+    std::memcpy(&header, file.bytes(), sizeof(header));
+
+    if(std::memcmp(header.magic, magic, sizeof(magic)) != 0){
+        std::cerr << path << " is not a model file" << std::endl;
+        return nullptr;
+    }
+
+    if(header.version != version){
+        std::cerr << path << " has an unsupported version (" << header.version << ")" << std::endl;
+        return nullptr;
+    }
+
+    if(header.kind != kind || header.weights != weights){
+        std::cerr << path << " does not contain a network of the expected kind" << std::endl;
+        return nullptr;
+    }
+
+    if(!header.layers || sizeof(header) + header.layers * sizeof(layer_record) > file.size){
+        std::cerr << path << " is truncated" << std::endl;
+        return nullptr;
+    }
+
+    return reinterpret_cast<const layer_record*>(file.bytes() + sizeof(header));
+}
+
+} //end of namespace model_file_detail
+
+/*!
+ * \brief Write a flat network as a model file.
+ */
+template<typename Network>
+bool write_model_file(const Network& network, const std::string& path){
+    using namespace model_file_detail;
+
+    file_header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.kind = kind_of(network);
+    header.weights = precision::FLOAT32;
+    header.layers = network.layers.size();
+    header.alignment = alignment;
+
+    std::vector<layer_record> records;
+
+    auto offset = align(sizeof(file_header) + network.layers.size() * sizeof(layer_record));
+
+    for(auto& layer : network.layers){
+        records.push_back(describe(layer));
+        records.back().offset = offset;
+        offset = align(offset + (records.back().weights + records.back().biases + records.back().visible_biases) * sizeof(float));
+    }
+
+    std::ofstream os(path, std::ofstream::binary | std::ofstream::trunc);
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(layer_record));
+
+    for(std::size_t l = 0; l < records.size(); ++l){
+        auto& record = records[l];
+        auto& layer = network.layers[l];
+
+        os.seekp(record.offset);
+        os.write(reinterpret_cast<const char*>(layer.weights), record.weights * sizeof(float));
+        os.write(reinterpret_cast<const char*>(layer.biases), record.biases * sizeof(float));
+        os.write(reinterpret_cast<const char*>(layer.visible_biases), record.visible_biases * sizeof(float));
+    }
+
+    //Pad the last block so that every block is a whole number of pages
+    if(offset > static_cast<uint64_t>(os.tellp())){
+        os.seekp(offset - 1);
+        os.put('\0');
+    }
+
+    if(!os){
+        std::cerr << "Impossible to write the model file " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Write a DBN as a model file.
+ *
+ * \return false if the DBN cannot be represented as a flat dense or
+ * convolutional network (see make_dense_network and make_conv_network).
+ */
+template<typename DBN>
+bool save_model_file(const DBN& dbn, const std::string& path){
+    auto dense = make_dense_network(dbn);
+    if(!dense.empty()){
+        return write_model_file(dense, path);
+    }
+
+    auto conv = make_conv_network(dbn);
+    if(!conv.empty()){
+        return write_model_file(conv, path);
+    }
+
+    return false;
+}
+
+/*!
+ * \brief Write a quantized network as an int8 model file.
+ */
+inline bool write_model_file(const quantized_network& network, const std::string& path){
+    using namespace model_file_detail;
+
+    file_header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.kind = kind_of(network);
+    header.weights = precision::INT8;
+    header.layers = network.layers.size();
+    header.alignment = alignment;
+
+    std::vector<layer_record> records;
+
+    auto offset = align(sizeof(file_header) + network.layers.size() * sizeof(layer_record));
+
+    for(auto& layer : network.layers){
+        records.push_back(describe(layer));
+        records.back().offset = offset;
+        offset = align(offset + quantized_block(records.back()));
+    }
+
+    std::ofstream os(path, std::ofstream::binary | std::ofstream::trunc);
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(layer_record));
+
+    for(std::size_t l = 0; l < records.size(); ++l){
+        auto& layer = network.layers[l];
+
+        quantized_params params{layer.weight_scale, layer.input_scale, layer.input_zero, 0};
+
+        os.seekp(records[l].offset);
+        os.write(reinterpret_cast<const char*>(&params), sizeof(params));
+        os.write(reinterpret_cast<const char*>(layer.biases.data()), layer.biases.size() * sizeof(float));
+        os.write(reinterpret_cast<const char*>(layer.sums.data()), layer.sums.size() * sizeof(int32_t));
+        os.write(reinterpret_cast<const char*>(layer.weights.data()), layer.weights.size());
+    }
+
+    if(offset > static_cast<uint64_t>(os.tellp())){
+        os.seekp(offset - 1);
+        os.put('\0');
+    }
+
+    if(!os){
+        std::cerr << "Impossible to write the model file " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Map a model file and return a network using the weights in place.
+ *
+ * The mapping lives as long as the network (and its copies). The
+ * returned network is empty if the file cannot be read, is not a valid
+ * model file or does not contain a network of this kind.
+ */
+template<typename Network>
+Network map_model_file(const std::string& path){
+    using namespace model_file_detail;
+
+    Network network;
+
+    auto file = std::make_shared<mapped_file>(path);
+
+    file_header header;
+    auto records = read_header(*file, path, kind_of(network), precision::FLOAT32, header);
+
+    if(!records){
+        return network;
+    }
+
+    for(std::size_t l = 0; l < header.layers; ++l){
+        auto& record = records[l];
+
+        if(!consistent(record, header.kind, header.weights) || record.offset % sizeof(float) || record.offset + (record.weights + record.biases + record.visible_biases) * sizeof(float) > file->size){
+            std::cerr << path << " has an invalid record for layer " << l << std::endl;
+            network.layers.clear();
+            return network;
+        }
+
+        network.layers.emplace_back();
+        bind(record, reinterpret_cast<const float*>(file->bytes() + record.offset), network.layers.back());
+    }
+
+    network.storage = file;
+
+    return network;
+}
+
+/*!
+ * \brief Map a model file and check that it has been written from a DBN
+ * of the same type as dbn (same layers, sizes and hidden and visible
+ * activations).
+ *
+ * The returned network is empty if the file is not valid or does not
+ * match the DBN.
+ */
+template<typename Network, typename DBN>
+Network map_model_file(const std::string& path, const DBN& dbn){
+    using model_file_detail::describe;
+
+    auto network = map_model_file<Network>(path);
+    auto expected = convert_detail::make_network<Network>(dbn);
+
+    if(network.empty() || expected.empty()){
+        return {};
+    }
+
+    if(network.layers.size() != expected.layers.size()){
+        std::cerr << path << " has " << network.layers.size() << " layers, the DBN has " << expected.layers.size() << std::endl;
+        return {};
+    }
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        auto actual = describe(network.layers[l]);
+        auto wanted = describe(expected.layers[l]);
+
+        if(!model_file_detail::same_shape(actual, wanted)){
+            using model_file_detail::operator<<;
+            std::cerr << path << ": layer " << l << " is " << actual << ", the DBN expects " << wanted << std::endl;
+            return {};
+        }
+    }
+
+    return network;
+}
+
+/*!
+ * \brief Read an int8 model file.
+ *
+ * The returned network is empty if the file cannot be read or is not a
+ * valid int8 model file.
+ */
+inline quantized_network read_quantized_model_file(const std::string& path){
+    using namespace model_file_detail;
+
+    quantized_network network;
+
+    mapped_file file(path);
+
+    file_header header;
+    auto records = read_header(file, path, network_kind::DENSE, precision::INT8, header);
+
+    if(!records){
+        return network;
+    }
+
+    for(std::size_t l = 0; l < header.layers; ++l){
+        auto& record = records[l];
+
+        if(!consistent(record, header.kind, header.weights) || record.offset % sizeof(float) || record.offset + quantized_block(record) > file.size){
+            std::cerr << path << " has an invalid record for layer " << l << std::endl;
+            network.layers.clear();
+            return network;
+        }
+
+        auto block = file.bytes() + record.offset;
+
+        quantized_params params;
+        std::memcpy(&params, block, sizeof(params));
+        block += sizeof(params);
+
+        quantized_layer layer;
+        layer.inputs = record.dims[0];
+        layer.outputs = record.dims[1];
+        layer.activation = record.activation;
+        layer.visible = record.visible;
+        layer.weight_scale = params.weight_scale;
+        layer.input_scale = params.input_scale;
+        layer.input_zero = params.input_zero;
+
+        layer.biases.resize(record.biases);
+        std::memcpy(layer.biases.data(), block, record.biases * sizeof(float));
+        block += record.biases * sizeof(float);
+
+        layer.sums.resize(record.biases);
+        std::memcpy(layer.sums.data(), block, record.biases * sizeof(int32_t));
+        block += record.biases * sizeof(int32_t);
+
+        layer.weights.resize(record.weights);
+        std::memcpy(layer.weights.data(), block, record.weights);
+
+        network.layers.push_back(std::move(layer));
+    }
+
+    return network;
+}
+
+/*!
+ * \brief Read an int8 model file and check that it has been quantized
+ * from a DBN of the same type as dbn.
+ *
+ * The returned network is empty if the file is not valid or does not
+ * match the DBN.
+ */
+template<typename DBN>
+quantized_network read_quantized_model_file(const std::string& path, const DBN& dbn){
+    using model_file_detail::describe;
+
+    auto network = read_quantized_model_file(path);
+    auto expected = make_dense_network(dbn);
+
+    if(network.empty() || expected.empty()){
+        return {};
+    }
+
+    if(network.layers.size() != expected.layers.size()){
+        std::cerr << path << " has " << network.layers.size() << " layers, the DBN has " << expected.layers.size() << std::endl;
+        return {};
+    }
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        auto actual = describe(network.layers[l]);
+        auto wanted = describe(expected.layers[l]);
+
+        if(!model_file_detail::same_shape(actual, wanted)){
+            using model_file_detail::operator<<;
+            std::cerr << path << ": layer " << l << " is " << actual << ", the DBN expects " << wanted << std::endl;
+            return {};
+        }
+    }
+
+    return network;
+}
+
+/*!
+ * \brief Load the weights and the hidden and visible biases of a model
+ * file into a DBN, after checking that the file matches the DBN.
+ */
+template<typename DBN>
+bool load_model_file(const std::string& path, DBN& dbn){
+    if(!make_dense_network(dbn).empty()){
+        auto network = map_model_file<dense_network>(path, dbn);
+
+        if(!network.empty()){
+            model_file_detail::restore_layers(dbn, network, std::integral_constant<std::size_t, 0>());
+            return true;
+        }
+    } else if(!make_conv_network(dbn).empty()){
+        auto network = map_model_file<conv_network>(path, dbn);
+
+        if(!network.empty()){
+            model_file_detail::restore_layers(dbn, network, std::integral_constant<std::size_t, 0>());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
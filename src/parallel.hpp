@@ -0,0 +1,126 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief Return the number of threads to use for the parallel loops
+ */
+inline std::size_t default_threads(){
+    auto threads = std::thread::hardware_concurrency();
+    return threads ? threads : 1;
+}
+
+/*!
+ * \brief Split [0, n) in batches and process them on several threads.
+ *
+ * The batches are distributed dynamically. The functor is called as
+ * functor(first, last, thread) where thread is in [0, threads) and can
+ * be used to index per-thread state.
+ *
+ * \return The number of threads effectively used
+ */
+template<typename Functor>
+std::size_t parallel_for_batches(std::size_t n, std::size_t batch_size, Functor&& functor, std::size_t threads = default_threads()){
+    auto batches = (n + batch_size - 1) / batch_size;
+
+    threads = std::max(std::size_t(1), std::min(threads, batches));
+
+    std::atomic<std::size_t> next(0);
+
+    auto worker = [&](std::size_t thread){
+        while(true){
+            auto batch = next++;
+
+            if(batch >= batches){
+                break;
+            }
+
+            auto first = batch * batch_size;
+            auto last = std::min(n, first + batch_size);
+
+            functor(first, last, thread);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+
+    for(std::size_t t = 1; t < threads; ++t){
+        pool.emplace_back(worker, t);
+    }
+
+    worker(0);
+
+    for(auto& thread : pool){
+        thread.join();
+    }
+
+    return threads;
+}
+
+/*!
+ * \brief Blocking FIFO queue with a maximum size, to connect the
+ * stages of a pipeline.
+ *
+ * push() blocks while the queue is full. Once the queue is closed, pop()
+ * returns false after the remaining elements have been consumed.
+ */
+template<typename T>
+struct bounded_queue {
+    explicit bounded_queue(std::size_t capacity) : capacity(std::max(std::size_t(1), capacity)) {}
+
+    void push(T value){
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]{ return queue.size() < capacity; });
+        queue.push_back(std::move(value));
+        not_empty.notify_one();
+    }
+
+    bool pop(T& value){
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]{ return !queue.empty() || closed; });
+
+        if(queue.empty()){
+            return false;
+        }
+
+        value = std::move(queue.front());
+        queue.pop_front();
+        not_full.notify_one();
+
+        return true;
+    }
+
+    /*!
+     * \brief Indicates that no more elements will be pushed
+     */
+    void close(){
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    bool closed = false;
+    std::deque<T> queue;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+};
+
+#endif
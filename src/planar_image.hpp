@@ -0,0 +1,101 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file planar_image.hpp
+ * \brief Padded, channel-major float images and their patches.
+ */
+
+#ifndef PLANAR_IMAGE_HPP
+#define PLANAR_IMAGE_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "sample_view.hpp"
+
+/*!
+ * \brief A multi-channel float image stored plane by plane
+ * (channels x height x width, row-major).
+ */
+struct planar_image {
+    std::size_t width = 0;
+    std::size_t height = 0;
+    std::size_t channels = 0;
+    std::vector<float> data;
+
+    planar_image() = default;
+
+    planar_image(std::size_t width, std::size_t height, std::size_t channels) : width(width), height(height), channels(channels), data(width * height * channels, 0.0f) {}
+
+    float* row(std::size_t channel, std::size_t y){
+        return &data[(channel * height + y) * width];
+    }
+
+    const float* row(std::size_t channel, std::size_t y) const {
+        return &data[(channel * height + y) * width];
+    }
+};
+
+/*!
+ * \brief Convert an RGB image to a planar image with a border of pad
+ * pixels, its dimensions being rounded up to a multiple of multiple.
+ */
+template<typename Image>
+planar_image make_planar_padded(const Image& image, std::size_t pad, std::size_t multiple){
+    auto width = image.width + 2 * pad;
+    auto height = image.height + 2 * pad;
+
+    width = (width + multiple - 1) / multiple * multiple;
+    height = (height + multiple - 1) / multiple * multiple;
+
+    planar_image planar(width, height, 3);
+
+    for(std::size_t y = 0; y < image.height; ++y){
+        auto source = &image.pixels[y * image.width];
+
+        auto r = planar.row(0, y + pad) + pad;
+        auto g = planar.row(1, y + pad) + pad;
+        auto b = planar.row(2, y + pad) + pad;
+
+        for(std::size_t x = 0; x < image.width; ++x){
+            r[x] = source[x].r;
+            g[x] = source[x].g;
+            b[x] = source[x].b;
+        }
+    }
+
+    return planar;
+}
+
+/*!
+ * \brief Append the non-overlapping window x window patches of an image
+ * to a batch, each patch being channel-major (channels x window x window).
+ *
+ * Each patch row is a contiguous copy of an image row.
+ */
+inline void extract_patches(const planar_image& image, std::size_t window, std::vector<float>& patches){
+    auto patch_size = image.channels * window * window;
+
+    for(std::size_t i = 0; i + window <= image.height; i += window){
+        for(std::size_t j = 0; j + window <= image.width; j += window){
+            auto offset = patches.size();
+            patches.resize(offset + patch_size);
+
+            auto patch = &patches[offset];
+
+            for(std::size_t c = 0; c < image.channels; ++c){
+                for(std::size_t row = 0; row < window; ++row){
+                    auto source = image.row(c, i + row) + j;
+                    std::copy(source, source + window, patch + (c * window + row) * window);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,182 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file prediction_server.hpp
+ * \brief Protocol shared by dbn_server and dbn_client.
+ *
+ * The messages are exchanged over a UNIX stream socket, in the byte
+ * order of the host. A request is a request_header followed, for a
+ * prediction, by size float values (one sample). The answer of a
+ * prediction is a uint32_t count followed by count float probabilities.
+ * The answer of a statistics request is a server_stats. The server
+ * closes the connection on an unknown request type or on a sample that
+ * has not the input size of the network.
+ */
+
+#ifndef PREDICTION_SERVER_HPP
+#define PREDICTION_SERVER_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+enum class request_type : uint32_t {
+    PREDICT = 0,
+    STATS   = 1
+};
+
+struct request_header {
+    request_type type;
+    uint32_t size; ///< Number of float values following the header
+};
+
+/*!
+ * \brief Counters of the server since its start. The latencies are
+ * measured from the reception of a request to the completion of its
+ * batch, over the most recent requests.
+ */
+struct server_stats {
+    uint64_t requests;
+    uint64_t batches;
+    double seconds;    ///< Time since the start of the server
+    double throughput; ///< Requests per second since the start
+    double p50_us;
+    double p99_us;
+    double mean_batch;
+};
+
+namespace server_detail {
+
+inline bool read_full(int fd, void* data, std::size_t size){
+    auto out = static_cast<char*>(data);
+
+    while(size){
+        auto n = ::read(fd, out, size);
+
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+
+        if(n <= 0){
+            return false;
+        }
+
+        out += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+inline bool write_full(int fd, const void* data, std::size_t size){
+    auto in = static_cast<const char*>(data);
+
+    while(size){
+        auto n = ::send(fd, in, size, MSG_NOSIGNAL);
+
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+
+        if(n <= 0){
+            return false;
+        }
+
+        in += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+inline bool make_address(const std::string& path, sockaddr_un& address){
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if(path.size() >= sizeof(address.sun_path)){
+        return false;
+    }
+
+    std::strcpy(address.sun_path, path.c_str());
+
+    return true;
+}
+
+} //end of namespace server_detail
+
+/*!
+ * \brief Return the q-quantile (q in [0, 1]) of the values, 0 if there are none
+ */
+inline double quantile(std::vector<double> values, double q){
+    if(values.empty()){
+        return 0.0;
+    }
+
+    auto rank = static_cast<std::size_t>(q * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+
+    return values[rank];
+}
+
+/*!
+ * \brief Connect to the server listening on path
+ * \return The socket, -1 on error
+ */
+inline int connect_server(const std::string& path){
+    sockaddr_un address;
+    if(!server_detail::make_address(path, address)){
+        return -1;
+    }
+
+    auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0){
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*!
+ * \brief Send one sample and wait for its class probabilities
+ */
+template<typename Sample>
+bool remote_predict(int fd, const Sample& sample, std::vector<float>& probabilities){
+    request_header header{request_type::PREDICT, static_cast<uint32_t>(sample.size())};
+
+    std::vector<float> values(sample.begin(), sample.end());
+
+    if(!server_detail::write_full(fd, &header, sizeof(header)) || !server_detail::write_full(fd, values.data(), values.size() * sizeof(float))){
+        return false;
+    }
+
+    uint32_t count;
+    if(!server_detail::read_full(fd, &count, sizeof(count))){
+        return false;
+    }
+
+    probabilities.resize(count);
+
+    return server_detail::read_full(fd, probabilities.data(), count * sizeof(float));
+}
+
+inline bool remote_stats(int fd, server_stats& stats){
+    request_header header{request_type::STATS, 0};
+
+    return server_detail::write_full(fd, &header, sizeof(header)) && server_detail::read_full(fd, &stats, sizeof(stats));
+}
+
+#endif
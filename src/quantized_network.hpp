@@ -0,0 +1,304 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file quantized_network.hpp
+ * \brief Int8 version of a dense_network for inference.
+ *
+ * The weights of each layer are quantized symmetrically to int8 with
+ * one scale per layer. The inputs of each layer are quantized to uint8
+ * with a scale and a zero point computed from a calibration set. Each
+ * output is an int32 dot product between the uint8 inputs and a
+ * contiguous int8 row of the weights, which the compiler vectorizes.
+ * The zero point is subtracted afterwards with the precomputed sum of
+ * the row:
+ *
+ *     y_j = b_j + s_x * s_w * (sum_k x_k w_kj - z * sum_k w_kj)
+ *
+ * The activation functions are computed in single precision.
+ *
+ * The quantization is meant to be done once: the quantized network can
+ * be saved as an int8 model file and read back by the scoring jobs (see
+ * model_file.hpp), which then need neither the float network nor the
+ * calibration samples.
+ */
+
+#ifndef QUANTIZED_NETWORK_HPP
+#define QUANTIZED_NETWORK_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "dense_network.hpp"
+#include "parallel.hpp"
+
+/*!
+ * \brief One quantized dense layer, owning its weights.
+ */
+struct quantized_layer {
+    std::size_t inputs;
+    std::size_t outputs;
+    dense_activation activation;
+    dense_activation visible;     ///< Activation of the visible units of the RBM, kept to check the model files
+    float weight_scale;
+    float input_scale;
+    int32_t input_zero;
+    std::vector<int8_t> weights;  ///< outputs x inputs, row-major (transposed)
+    std::vector<int32_t> sums;    ///< Sum of each row of weights
+    std::vector<float> biases;
+};
+
+struct quantized_network {
+    std::vector<quantized_layer> layers;
+
+    bool empty() const {
+        return layers.empty();
+    }
+
+    std::size_t input_size() const {
+        return layers.front().inputs;
+    }
+
+    std::size_t output_size() const {
+        return layers.back().outputs;
+    }
+
+    std::size_t max_width() const {
+        std::size_t width = 0;
+        for(auto& layer : layers){
+            width = std::max(width, std::max(layer.inputs, layer.outputs));
+        }
+        return width;
+    }
+};
+
+/*!
+ * \brief Temporary buffers for the propagation of a batch
+ */
+struct quantized_workspace {
+    std::vector<uint8_t> input;
+    std::vector<float> a;
+    std::vector<float> b;
+
+    void prepare(const quantized_network& network, std::size_t batch){
+        auto size = batch * network.max_width();
+
+        if(a.size() < size){
+            input.resize(size);
+            a.resize(size);
+            b.resize(size);
+        }
+    }
+};
+
+namespace quantized_detail {
+
+/*!
+ * \brief Range of the values seen at the input of each layer
+ */
+struct input_range {
+    float min = 0.0f;
+    float max = 0.0f;
+
+    void add(const float* values, std::size_t n){
+        auto mm = std::minmax_element(values, values + n);
+        min = std::min(min, *mm.first);
+        max = std::max(max, *mm.second);
+    }
+};
+
+/*!
+ * \brief Propagate the calibration samples through the float network and
+ * record the range of the inputs of each layer. 0 is always in the range
+ * so that it is represented exactly.
+ */
+template<typename Images>
+std::vector<input_range> calibrate(const dense_network& network, const Images& images, std::size_t samples){
+    constexpr const std::size_t batch_size = 256;
+
+    std::vector<input_range> ranges(network.layers.size());
+
+    samples = std::min(samples, static_cast<std::size_t>(images.size()));
+
+    std::vector<float> input;
+    std::vector<float> output;
+
+    for(std::size_t first = 0; first < samples; first += batch_size){
+        auto last = std::min(samples, first + batch_size);
+        auto batch = last - first;
+
+        gather_batch(images, first, last, network.input_size(), input);
+
+        for(std::size_t l = 0; l < network.layers.size(); ++l){
+            auto& layer = network.layers[l];
+
+            ranges[l].add(input.data(), input.size());
+
+            output.resize(batch * layer.outputs);
+            dense_layer_forward(layer, input.data(), batch, output.data());
+
+            std::swap(input, output);
+        }
+    }
+
+    return ranges;
+}
+
+inline quantized_layer quantize_layer(const dense_layer& layer, const input_range& range){
+    quantized_layer q;
+    q.inputs = layer.inputs;
+    q.outputs = layer.outputs;
+    q.activation = layer.activation;
+    q.visible = layer.visible;
+
+    auto w_max = 0.0f;
+    for(std::size_t i = 0; i < layer.inputs * layer.outputs; ++i){
+        w_max = std::max(w_max, std::abs(layer.weights[i]));
+    }
+
+    q.weight_scale = w_max > 0.0f ? w_max / 127.0f : 1.0f;
+    q.input_scale = range.max > range.min ? (range.max - range.min) / 255.0f : 1.0f;
+    q.input_zero = std::min(255l, std::max(0l, std::lrint(-range.min / q.input_scale)));
+
+    q.weights.resize(layer.inputs * layer.outputs);
+    q.sums.assign(layer.outputs, 0);
+
+    for(std::size_t j = 0; j < layer.outputs; ++j){
+        for(std::size_t k = 0; k < layer.inputs; ++k){
+            auto w = static_cast<int8_t>(std::lrint(layer.weights[k * layer.outputs + j] / q.weight_scale));
+
+            q.weights[j * layer.inputs + k] = w;
+            q.sums[j] += w;
+        }
+    }
+
+    q.biases.assign(layer.biases, layer.biases + layer.outputs);
+
+    return q;
+}
+
+inline void quantize_input(const quantized_layer& layer, const float* input, std::size_t n, uint8_t* output){
+    auto inverse = 1.0f / layer.input_scale;
+
+    for(std::size_t i = 0; i < n; ++i){
+        auto q = std::lrint(input[i] * inverse) + layer.input_zero;
+        output[i] = static_cast<uint8_t>(std::min(255l, std::max(0l, q)));
+    }
+}
+
+//Both factors fit in 16 bits, which lets the compiler use the 16-bit multiply-add instructions
+inline int32_t dot(const uint8_t* x, const int8_t* w, std::size_t n){
+    int32_t acc = 0;
+
+    for(std::size_t k = 0; k < n; ++k){
+        acc += static_cast<int16_t>(x[k]) * static_cast<int16_t>(w[k]);
+    }
+
+    return acc;
+}
+
+} //end of namespace quantized_detail
+
+/*!
+ * \brief Quantize a dense network, the ranges of the activations being
+ * measured on the first samples of images.
+ */
+template<typename Images>
+quantized_network quantize_network(const dense_network& network, const Images& images, std::size_t samples = 1000){
+    quantized_network quantized;
+
+    if(network.empty()){
+        return quantized;
+    }
+
+    auto ranges = quantized_detail::calibrate(network, images, samples);
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        quantized.layers.push_back(quantized_detail::quantize_layer(network.layers[l], ranges[l]));
+    }
+
+    return quantized;
+}
+
+/*!
+ * \brief Compute the activation probabilities of one quantized layer for a batch.
+ * \param quantized Buffer of at least batch x inputs bytes for the quantized inputs
+ */
+inline void quantized_layer_forward(const quantized_layer& layer, const float* input, std::size_t batch, float* output, uint8_t* quantized){
+    quantized_detail::quantize_input(layer, input, batch * layer.inputs, quantized);
+
+    auto scale = layer.input_scale * layer.weight_scale;
+
+    for(std::size_t i = 0; i < batch; ++i){
+        auto x = quantized + i * layer.inputs;
+        auto out = output + i * layer.outputs;
+
+        for(std::size_t j = 0; j < layer.outputs; ++j){
+            auto acc = quantized_detail::dot(x, &layer.weights[j * layer.inputs], layer.inputs) - layer.input_zero * layer.sums[j];
+            out[j] = layer.biases[j] + scale * acc;
+        }
+    }
+
+    dense_detail::activate(layer.activation, output, batch, layer.outputs);
+}
+
+/*!
+ * \brief Propagate a batch of samples through the complete quantized network.
+ */
+inline void quantized_forward(const quantized_network& network, const float* input, std::size_t batch, float* output, quantized_workspace& workspace){
+    workspace.prepare(network, batch);
+
+    const float* current = input;
+
+    for(std::size_t l = 0; l < network.layers.size(); ++l){
+        auto& layer = network.layers[l];
+
+        float* next = l + 1 == network.layers.size() ? output : (l % 2 == 0 ? workspace.a.data() : workspace.b.data());
+
+        quantized_layer_forward(layer, current, batch, next, workspace.input.data());
+
+        current = next;
+    }
+}
+
+/*!
+ * \brief Compute the error rate of a quantized network on a set of samples.
+ */
+template<typename Images, typename Labels>
+double quantized_test_set(const quantized_network& network, const Images& images, const Labels& labels){
+    constexpr const std::size_t batch_size = 256;
+
+    auto threads = default_threads();
+
+    std::vector<std::size_t> errors(threads, 0);
+
+    parallel_for_batches(images.size(), batch_size, [&](std::size_t first, std::size_t last, std::size_t thread){
+        std::vector<float> input;
+        std::vector<float> output((last - first) * network.output_size());
+        quantized_workspace workspace;
+
+        gather_batch(images, first, last, network.input_size(), input);
+        quantized_forward(network, input.data(), last - first, output.data(), workspace);
+
+        for(std::size_t i = first; i < last; ++i){
+            if(dense_argmax(&output[(i - first) * network.output_size()], network.output_size()) != labels[i]){
+                ++errors[thread];
+            }
+        }
+    }, threads);
+
+    std::size_t total = 0;
+    for(auto e : errors){
+        total += e;
+    }
+
+    return images.empty() ? 0.0 : static_cast<double>(total) / images.size();
+}
+
+#endif
@@ -10,13 +10,22 @@
 #include "dll/rbm.hpp"
 #include "dll/ocv_visualizer.hpp"
 
-#include "mnist/mnist_reader.hpp"
-#include "mnist/mnist_utils.hpp"
+#include "async_visualizer.hpp"
+#include "checkpoint.hpp"
+#include "mnist_cache.hpp"
+#include "telemetry.hpp"
+
+template<typename RBM>
+using telemetry = telemetry_watcher<RBM>;
 
 int main(int argc, char* argv[]){
     auto reconstruction = false;
     auto load = false;
     auto view = false;
+    auto async = false;
+    auto telemetry_log = false;
+    auto checkpoint = false;
+    auto resume = false;
 
     //TODO Add support for gray images
 
@@ -29,29 +38,38 @@ int main(int argc, char* argv[]){
             load = true;
         } else if(command == "view"){
             view = true;
+        } else if(command == "async"){
+            view = true;
+            async = true;
+        } else if(command == "telemetry"){
+            telemetry_log = true;
+        } else if(command == "checkpoint"){
+            checkpoint = true;
+        } else if(command == "resume"){
+            checkpoint = true;
+            resume = true;
         }
     }
 
-    auto dataset = mnist::read_dataset_direct<std::vector, etl::dyn_vector<float>>(1000);
+    auto dataset = read_cached_dataset<float>(1000, cache_mode::BINARIZE);
 
     if(dataset.training_images.empty() || dataset.training_labels.empty()){
         std::cout << "Impossible to read dataset" << std::endl;
         return 1;
     }
 
-    mnist::binarize_dataset(dataset);
-
-    if(!view){
-      dll::rbm_desc<28 * 28, 200, dll::momentum, dll::batch_size<25>
-                    // dll::hidden<dll::unit_type::RELU>,
-                    // dll::visible<dll::unit_type::GAUSSIAN>
-                    >::layer_t rbm;
-
+    auto run = [&](auto& rbm){
         if(load){
             std::ifstream is("rbm-1.dat", std::ofstream::binary);
             rbm.load(is);
         } else {
-            rbm.train(dataset.training_images, 25);
+            if(checkpoint && telemetry_log){
+                checkpointed_train<telemetry>(rbm, dataset.training_images, 25, "rbm-1.ckpt", checkpoint_policy::parse(argc, argv), resume);
+            } else if(checkpoint){
+                checkpointed_train(rbm, dataset.training_images, 25, "rbm-1.ckpt", checkpoint_policy::parse(argc, argv), resume);
+            } else {
+                rbm.train(dataset.training_images, 25);
+            }
 
             std::ofstream os("rbm-1.dat", std::ofstream::binary);
             rbm.store(os);
@@ -76,24 +94,54 @@ int main(int argc, char* argv[]){
                 rbm.display_visible_units(28);
             }
         }
+    };
+
+    if(!view && !telemetry_log){
+      dll::rbm_desc<28 * 28, 200, dll::momentum, dll::batch_size<25>
+                    // dll::hidden<dll::unit_type::RELU>,
+                    // dll::visible<dll::unit_type::GAUSSIAN>
+                    >::layer_t rbm;
+
+        run(rbm);
+    } else if(!view){
+      dll::rbm_desc<28 * 28, 200, dll::momentum, dll::batch_size<25>,
+                    dll::watcher<telemetry>>::layer_t rbm;
+
+        run(rbm);
     } else {
-      dll::rbm_desc<28 * 28, 14 * 14,
-                    // dll::init_weights,
-                    dll::momentum,
-                    dll::weight_decay<dll::decay_type::L2>,
-                    dll::sparsity<dll::sparsity_method::LOCAL_TARGET>,
-                    dll::trainer_rbm<dll::pcd1_trainer_t>,
-                    // dll::init_weights,
-                    dll::batch_size<50>,
-                    // dll::visible<dll::unit_type::GAUSSIAN>,
-                    dll::watcher<dll::opencv_rbm_visualizer>>::layer_t rbm;
-
-        //rbm.momentum = 0.9;
-        rbm.sparsity_target = 0.01;
-        //rbm.sparsity_cost = 0.9;
-        rbm.learning_rate /= 10.0;
-
-        rbm.train(dataset.training_images, 500);
+        auto train_view = [&](auto& rbm){
+            //rbm.momentum = 0.9;
+            rbm.sparsity_target = 0.01;
+            //rbm.sparsity_cost = 0.9;
+            rbm.learning_rate /= 10.0;
+
+            rbm.train(dataset.training_images, 500);
+        };
+
+        if(!async){
+          dll::rbm_desc<28 * 28, 14 * 14,
+                        // dll::init_weights,
+                        dll::momentum,
+                        dll::weight_decay<dll::decay_type::L2>,
+                        dll::sparsity<dll::sparsity_method::LOCAL_TARGET>,
+                        dll::trainer_rbm<dll::pcd1_trainer_t>,
+                        // dll::init_weights,
+                        dll::batch_size<50>,
+                        // dll::visible<dll::unit_type::GAUSSIAN>,
+                        dll::watcher<dll::opencv_rbm_visualizer>>::layer_t rbm;
+
+            train_view(rbm);
+        } else {
+          dll::rbm_desc<28 * 28, 14 * 14,
+                        dll::momentum,
+                        dll::weight_decay<dll::decay_type::L2>,
+                        dll::sparsity<dll::sparsity_method::LOCAL_TARGET>,
+                        dll::trainer_rbm<dll::pcd1_trainer_t>,
+                        dll::batch_size<50>,
+                        dll::watcher<async_rbm_visualizer>>::layer_t rbm;
+
+            train_view(rbm);
+        }
     }
 
     return 0;
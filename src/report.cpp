@@ -0,0 +1,336 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*
+ * Render the reports/epoch_* dumps of a training into PNG montages:
+ *  - hiddens_weights.png: the 28x28 filter of each hidden unit (h_*.dat), 10 per row
+ *  - histograms.png: the histograms of the hiddens, weights and visibles
+ *    and of their increments, 3x2
+ *
+ * Both are also copied into reports/finals/ with the name of the epoch.
+ *
+ * Given a telemetry log (.bin, see telemetry_record.hpp) instead, the recorded
+ * histograms of each layer and epoch are rendered into reports/finals/.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "parallel.hpp"
+#include "telemetry_record.hpp"
+
+namespace {
+
+constexpr const std::size_t tile_size = 50;
+constexpr const std::size_t tile_columns = 10;
+constexpr const std::size_t histogram_size = 250;
+
+std::vector<std::string> list_directory(const std::string& path){
+    std::vector<std::string> names;
+
+    if(auto dir = opendir(path.c_str())){
+        while(auto entry = readdir(dir)){
+            names.emplace_back(entry->d_name);
+        }
+
+        closedir(dir);
+    }
+
+    std::sort(names.begin(), names.end());
+
+    return names;
+}
+
+bool starts_with(const std::string& s, const std::string& prefix){
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool ends_with(const std::string& s, const std::string& suffix){
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+//Color of v in [0, 1] with the gnuplot default palette (rgbformulae 7,5,15)
+cv::Vec3b palette(double v){
+    auto clip = [](double x){ return static_cast<uint8_t>(std::lrint(255.0 * std::min(1.0, std::max(0.0, x)))); };
+
+    auto r = std::sqrt(v);
+    auto g = v * v * v;
+    auto b = std::sin(2.0 * M_PI * v);
+
+    return {clip(b), clip(g), clip(r)};
+}
+
+/*!
+ * \brief Render a square binary float array (h_*.dat), scaled to its
+ * own range like gnuplot, the first row at the bottom.
+ */
+cv::Mat render_filter(const std::string& path){
+    cv::Mat tile(tile_size, tile_size, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    std::ifstream is(path, std::ifstream::binary | std::ifstream::ate);
+    std::vector<float> values(is ? static_cast<std::size_t>(is.tellg()) / sizeof(float) : 0);
+
+    is.seekg(0);
+    is.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+
+    auto side = static_cast<std::size_t>(std::lrint(std::sqrt(values.size())));
+
+    if(side == 0 || side * side != values.size()){
+        return tile;
+    }
+
+    auto min = *std::min_element(values.begin(), values.end());
+    auto max = *std::max_element(values.begin(), values.end());
+    auto range = max > min ? max - min : 1.0f;
+
+    cv::Mat image(side, side, CV_8UC3);
+
+    for(std::size_t y = 0; y < side; ++y){
+        auto row = image.ptr<cv::Vec3b>(side - 1 - y);
+        for(std::size_t x = 0; x < side; ++x){
+            row[x] = palette((values[y * side + x] - min) / range);
+        }
+    }
+
+    cv::resize(image, tile, tile.size(), 0, 0, cv::INTER_NEAREST);
+
+    return tile;
+}
+
+/*!
+ * \brief Draw equal-width bins covering [low, high] as boxes
+ */
+cv::Mat draw_histogram(const std::vector<std::size_t>& bins, double low, double high){
+    cv::Mat image(histogram_size, histogram_size, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    if(bins.empty()){
+        return image;
+    }
+
+    auto max_count = *std::max_element(bins.begin(), bins.end());
+
+    const int margin = 20;
+    const int plot = histogram_size - 2 * margin;
+
+    auto scale = static_cast<double>(plot) / bins.size();
+
+    //Several bins can fall in the same column, the highest is drawn
+    std::vector<std::size_t> columns(plot, 0);
+    for(std::size_t i = 0; i < bins.size(); ++i){
+        auto left = static_cast<int>(i * scale);
+        auto right = std::max(left + 1, static_cast<int>((i + 1) * scale));
+
+        for(int x = left; x < std::min(right, plot); ++x){
+            columns[x] = std::max(columns[x], bins[i]);
+        }
+    }
+
+    for(int x = 0; x < plot && max_count; ++x){
+        if(columns[x]){
+            auto h = static_cast<int>(std::lrint(static_cast<double>(columns[x]) / max_count * plot));
+            cv::line(image, cv::Point(margin + x, margin + plot), cv::Point(margin + x, margin + plot - h), cv::Scalar(211, 0, 148));
+        }
+    }
+
+    cv::rectangle(image, cv::Point(margin, margin), cv::Point(margin + plot, margin + plot), cv::Scalar(0, 0, 0));
+
+    char label[32];
+    std::snprintf(label, sizeof(label), "%g", low);
+    cv::putText(image, label, cv::Point(margin, histogram_size - 5), cv::FONT_HERSHEY_PLAIN, 0.8, cv::Scalar(0, 0, 0));
+    std::snprintf(label, sizeof(label), "%g", high);
+    cv::putText(image, label, cv::Point(histogram_size - margin - 8 * std::strlen(label), histogram_size - 5), cv::FONT_HERSHEY_PLAIN, 0.8, cv::Scalar(0, 0, 0));
+
+    return image;
+}
+
+/*!
+ * \brief Render the histogram (with the given bin width) of the first
+ * column of a text file, as boxes.
+ */
+cv::Mat render_histogram(const std::string& path, double binwidth){
+    std::map<long, std::size_t> sparse;
+
+    std::ifstream is(path);
+    std::string line;
+    while(std::getline(is, line)){
+        double value;
+        if(std::sscanf(line.c_str(), "%lf", &value) == 1 && std::isfinite(value)){
+            ++sparse[static_cast<long>(std::floor(value / binwidth))];
+        }
+    }
+
+    if(sparse.empty()){
+        return draw_histogram({}, 0.0, 0.0);
+    }
+
+    auto first = sparse.begin()->first;
+    auto last = sparse.rbegin()->first + 1;
+
+    std::vector<std::size_t> bins(last - first, 0);
+    for(auto& bin : sparse){
+        bins[bin.first - first] = bin.second;
+    }
+
+    return draw_histogram(bins, first * binwidth, last * binwidth);
+}
+
+//Concatenate the tiles (all of the same size) in a grid with the given number of columns
+cv::Mat montage(const std::vector<cv::Mat>& tiles, std::size_t columns){
+    if(tiles.empty()){
+        return {};
+    }
+
+    auto rows = (tiles.size() + columns - 1) / columns;
+    columns = std::min(columns, tiles.size());
+
+    cv::Mat image(rows * tiles[0].rows, columns * tiles[0].cols, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    for(std::size_t i = 0; i < tiles.size(); ++i){
+        cv::Rect roi((i % columns) * tiles[0].cols, (i / columns) * tiles[0].rows, tiles[0].cols, tiles[0].rows);
+        tiles[i].copyTo(image(roi));
+    }
+
+    return image;
+}
+
+//Index of a h_<i>.dat file
+long hidden_index(const std::string& name){
+    return std::strtol(name.c_str() + 2, nullptr, 10);
+}
+
+void process_epoch(const std::string& reports, const std::string& epoch){
+    auto dir = reports + "/" + epoch;
+
+    std::vector<std::string> filters;
+    for(auto& name : list_directory(dir)){
+        if(starts_with(name, "h_") && ends_with(name, ".dat")){
+            filters.push_back(name);
+        }
+    }
+
+    std::sort(filters.begin(), filters.end(), [](const std::string& lhs, const std::string& rhs){
+        return hidden_index(lhs) < hidden_index(rhs);
+    });
+
+    std::vector<cv::Mat> tiles;
+    for(auto& name : filters){
+        tiles.push_back(render_filter(dir + "/" + name));
+    }
+
+    if(!tiles.empty()){
+        auto image = montage(tiles, tile_columns);
+        cv::imwrite(dir + "/hiddens_weights.png", image);
+        cv::imwrite(reports + "/finals/hiddens_weights_" + epoch + ".png", image);
+    }
+
+    static const std::pair<const char*, double> histograms[] = {
+        {"hiddens", 0.01}, {"weights", 0.001}, {"visibles", 0.001},
+        {"hiddens_inc", 0.0001}, {"weights_inc", 0.0001}, {"visibles_inc", 0.0001}};
+
+    std::vector<cv::Mat> plots;
+    for(auto& histogram : histograms){
+        plots.push_back(render_histogram(dir + "/" + histogram.first + ".dat", histogram.second));
+    }
+
+    auto image = montage(plots, 3);
+    cv::imwrite(dir + "/histograms.png", image);
+    cv::imwrite(reports + "/finals/histograms_" + epoch + ".png", image);
+}
+
+/*!
+ * \brief Render the histograms of a telemetry log, one montage per layer
+ * and per epoch, in reports/finals/
+ */
+int process_telemetry(const std::string& path, const std::string& reports){
+    auto records = read_telemetry(path);
+
+    if(records.empty()){
+        std::cout << "No telemetry records in " << path << std::endl;
+        return 1;
+    }
+
+    mkdir(reports.c_str(), 0755);
+    mkdir((reports + "/finals").c_str(), 0755);
+
+    //The records of an epoch of a layer are contiguous
+    std::vector<std::pair<std::size_t, std::size_t>> groups;
+    for(std::size_t i = 0; i < records.size(); ++i){
+        if(groups.empty() || records[i].layer != records[groups.back().first].layer || records[i].epoch != records[groups.back().first].epoch){
+            groups.emplace_back(i, i);
+        }
+
+        groups.back().second = i + 1;
+    }
+
+    parallel_for_batches(groups.size(), 1, [&](std::size_t first, std::size_t last, std::size_t /*thread*/){
+        for(std::size_t g = first; g < last; ++g){
+            std::vector<cv::Mat> plots;
+
+            for(std::size_t i = groups[g].first; i < groups[g].second; ++i){
+                auto& record = records[i];
+                std::vector<std::size_t> bins(record.bins.begin(), record.bins.end());
+
+                plots.push_back(draw_histogram(bins, record.min, record.max));
+                cv::putText(plots.back(), record.name, cv::Point(20, 15), cv::FONT_HERSHEY_PLAIN, 0.8, cv::Scalar(0, 0, 0));
+            }
+
+            auto& record = records[groups[g].first];
+            cv::imwrite(reports + "/finals/histograms_layer_" + std::to_string(record.layer) + "_epoch_" + std::to_string(record.epoch) + ".png", montage(plots, 3));
+        }
+    });
+
+    std::cout << groups.size() << " epochs rendered" << std::endl;
+
+    return 0;
+}
+
+} //end of anonymous namespace
+
+int main(int argc, char* argv[]){
+    std::string reports = argc > 1 ? argv[1] : "reports";
+
+    if(ends_with(reports, ".bin")){
+        return process_telemetry(reports, argc > 2 ? argv[2] : "reports");
+    }
+
+    std::vector<std::string> epochs;
+    for(auto& name : list_directory(reports)){
+        if(starts_with(name, "epoch_")){
+            epochs.push_back(name);
+        }
+    }
+
+    if(epochs.empty()){
+        std::cout << "No epoch_* directory in " << reports << std::endl;
+        return 1;
+    }
+
+    mkdir((reports + "/finals").c_str(), 0755);
+
+    parallel_for_batches(epochs.size(), 1, [&](std::size_t first, std::size_t last, std::size_t /*thread*/){
+        for(std::size_t i = first; i < last; ++i){
+            process_epoch(reports, epochs[i]);
+        }
+    });
+
+    std::cout << epochs.size() << " epochs rendered" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file reservoir.hpp
+ * \brief Uniform sampling of a fixed number of items from a stream.
+ */
+
+#ifndef RESERVOIR_HPP
+#define RESERVOIR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+/*!
+ * \brief Reservoir sampler (Li's algorithm L).
+ *
+ * After n offers, the reservoir holds a uniform random subset of
+ * min(n, capacity) of the offered items. The random generator is only
+ * used when an item enters the reservoir, so the cost of an offer that
+ * is skipped is a counter increment. The items are only built when
+ * they are accepted.
+ */
+template<typename T>
+struct reservoir_sampler {
+    std::size_t capacity;
+    std::size_t seen = 0;
+    std::vector<T> samples;
+
+    explicit reservoir_sampler(std::size_t capacity) : capacity(capacity) {
+        samples.reserve(capacity);
+    }
+
+    /*!
+     * \brief Offer the next item of the stream
+     * \param make Functor building the item, only called if the item is kept
+     */
+    template<typename RNG, typename Functor>
+    void offer(RNG& g, Functor&& make){
+        if(!capacity){
+            ++seen;
+            return;
+        }
+
+        if(samples.size() < capacity){
+            samples.push_back(make());
+
+            if(samples.size() == capacity){
+                w = std::exp(std::log(random(g)) / capacity);
+                next = seen + 1 + skip(g);
+            }
+        } else if(seen == next){
+            std::uniform_int_distribution<std::size_t> slot(0, capacity - 1);
+            samples[slot(g)] = make();
+
+            w *= std::exp(std::log(random(g)) / capacity);
+            next += 1 + skip(g);
+        }
+
+        ++seen;
+    }
+
+    /*!
+     * \brief Shuffle the samples, the order of a reservoir is not random
+     */
+    template<typename RNG>
+    void shuffle(RNG& g){
+        std::shuffle(samples.begin(), samples.end(), g);
+    }
+
+private:
+    double w = 1.0;
+    std::size_t next = 0;
+
+    template<typename RNG>
+    static double random(RNG& g){
+        std::uniform_real_distribution<double> dist(std::numeric_limits<double>::min(), 1.0);
+        return dist(g);
+    }
+
+    template<typename RNG>
+    std::size_t skip(RNG& g){
+        auto s = std::floor(std::log(random(g)) / std::log1p(-w));
+        return s < static_cast<double>(std::numeric_limits<std::size_t>::max() / 2) ? static_cast<std::size_t>(s) : std::numeric_limits<std::size_t>::max() / 2;
+    }
+};
+
+/*!
+ * \brief Reservoir sampler with one reservoir per class.
+ *
+ * Each class receives capacity / classes slots, which gives a balanced
+ * sample as long as every class has enough items.
+ */
+template<typename T>
+struct stratified_sampler {
+    std::vector<reservoir_sampler<T>> reservoirs;
+
+    stratified_sampler(std::size_t capacity, std::size_t classes) : reservoirs(classes, reservoir_sampler<T>(capacity / classes)) {}
+
+    template<typename RNG, typename Functor>
+    void offer(std::size_t label, RNG& g, Functor&& make){
+        reservoirs[label].offer(g, std::forward<Functor>(make));
+    }
+
+    std::size_t seen() const {
+        std::size_t seen = 0;
+        for(auto& reservoir : reservoirs){
+            seen += reservoir.seen;
+        }
+        return seen;
+    }
+
+    /*!
+     * \brief Concatenate and shuffle the samples of all the classes
+     */
+    template<typename RNG>
+    std::vector<T> samples(RNG& g) const {
+        std::vector<T> samples;
+
+        for(auto& reservoir : reservoirs){
+            samples.insert(samples.end(), reservoir.samples.begin(), reservoir.samples.end());
+        }
+
+        std::shuffle(samples.begin(), samples.end(), g);
+
+        return samples;
+    }
+};
+
+#endif
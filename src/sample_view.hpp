@@ -0,0 +1,94 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+#ifndef SAMPLE_VIEW_HPP
+#define SAMPLE_VIEW_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * \brief A non-owning view of one sample stored in a larger buffer.
+ *
+ * The view exposes the container interface expected by dll and etl
+ * (value_type, size(), operator[] and iterators). T can be const for
+ * read-only views.
+ */
+template<typename T>
+struct sample_view {
+    using value_type = std::remove_const_t<T>;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    T* first = nullptr;
+    std::size_t n = 0;
+
+    sample_view() = default;
+    sample_view(T* first, std::size_t n) : first(first), n(n) {}
+
+    std::size_t size() const {
+        return n;
+    }
+
+    T* data() const {
+        return first;
+    }
+
+    T& operator[](std::size_t i) const {
+        return first[i];
+    }
+
+    T* begin() const {
+        return first;
+    }
+
+    T* end() const {
+        return first + n;
+    }
+};
+
+/*!
+ * \brief Samples gathered into one contiguous buffer.
+ *
+ * The samples are views into data, so a batch can be moved but not
+ * copied.
+ */
+template<typename T>
+struct sample_batch {
+    std::vector<T> data;
+    std::vector<sample_view<T>> samples;
+
+    sample_batch() = default;
+    sample_batch(sample_batch&&) = default;
+    sample_batch& operator=(sample_batch&&) = default;
+
+    sample_batch(const sample_batch&) = delete;
+    sample_batch& operator=(const sample_batch&) = delete;
+
+    /*!
+     * \brief Allocate n samples of the given size, all views being set
+     */
+    void resize(std::size_t n, std::size_t sample_size){
+        data.assign(n * sample_size, T());
+        make_views(sample_size);
+    }
+
+    /*!
+     * \brief Rebuild the views after data has been filled directly
+     */
+    void make_views(std::size_t sample_size){
+        samples.clear();
+        samples.reserve(data.size() / sample_size);
+
+        for(std::size_t i = 0; i < data.size() / sample_size; ++i){
+            samples.emplace_back(data.data() + i * sample_size, sample_size);
+        }
+    }
+};
+
+#endif
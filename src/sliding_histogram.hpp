@@ -0,0 +1,131 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file sliding_histogram.hpp
+ * \brief Incremental intensity histograms of sliding windows.
+ */
+
+#ifndef SLIDING_HISTOGRAM_HPP
+#define SLIDING_HISTOGRAM_HPP
+
+#include <array>
+#include <cstdint>
+
+/*!
+ * \brief 256-bin histogram that maintains its number of peaks.
+ *
+ * A peak is a run of non-empty bins followed by an empty bin, exactly
+ * as counted by count_peaks. The count is updated in constant time
+ * when a bin becomes empty or non-empty.
+ */
+struct sliding_histogram {
+    std::array<uint32_t, 256> counts;
+    std::size_t ends = 0;
+
+    sliding_histogram(){
+        clear();
+    }
+
+    void clear(){
+        counts.fill(0);
+        ends = 0;
+    }
+
+    void add(uint8_t v){
+        if(counts[v]++ == 0){
+            toggle(v);
+        }
+    }
+
+    void remove(uint8_t v){
+        if(--counts[v] == 0){
+            toggle(v);
+        }
+    }
+
+    /*!
+     * \brief Return the number of peaks of the histogram
+     */
+    std::size_t peaks() const {
+        return ends;
+    }
+
+private:
+    //Is a peak ending at bin i (i non-empty, i + 1 empty)
+    bool end(std::size_t i) const {
+        return i < 255 && counts[i] && !counts[i + 1];
+    }
+
+    //Bin v just switched between empty and non-empty, only the ends at v - 1 and v can change
+    void toggle(uint8_t v){
+        //Recompute the two ends as if v had its previous state
+        bool now = counts[v] > 0;
+
+        std::size_t before = 0;
+        std::size_t after = 0;
+
+        if(v > 0){
+            before += counts[v - 1] && now;
+            after += end(v - 1);
+        }
+
+        before += v < 255 && !now && !counts[v + 1];
+        after += end(v);
+
+        ends = ends + after - before;
+    }
+};
+
+/*!
+ * \brief Call functor(x, y, histogram) for each window x window region
+ * of a single channel 8-bit image at (x * step, y * step), with
+ * x * step + window < width and y * step + window < height.
+ *
+ * The windows of a column strip are visited from top to bottom: moving
+ * down only removes the step rows leaving the window and adds the step
+ * rows entering it.
+ */
+template<typename Functor>
+void sliding_windows(const uint8_t* data, std::size_t stride, std::size_t width, std::size_t height, std::size_t window, std::size_t step, Functor&& functor){
+    sliding_histogram histogram;
+
+    for(std::size_t x = 0; x * step + window < width; ++x){
+        auto left = x * step;
+
+        histogram.clear();
+
+        for(std::size_t row = 0; row < window; ++row){
+            auto r = data + row * stride + left;
+            for(std::size_t col = 0; col < window; ++col){
+                histogram.add(r[col]);
+            }
+        }
+
+        for(std::size_t y = 0; y * step + window < height; ++y){
+            functor(x, y, static_cast<const sliding_histogram&>(histogram));
+
+            auto top = y * step;
+
+            if((y + 1) * step + window >= height){
+                break;
+            }
+
+            for(std::size_t row = top; row < top + step; ++row){
+                auto leaving = data + row * stride + left;
+                auto entering = data + (row + window) * stride + left;
+
+                for(std::size_t col = 0; col < window; ++col){
+                    histogram.remove(leaving[col]);
+                    histogram.add(entering[col]);
+                }
+            }
+        }
+    }
+}
+
+#endif
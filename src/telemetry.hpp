@@ -0,0 +1,200 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file telemetry.hpp
+ * \brief Streaming histograms and statistics of the RBM parameters during training.
+ *
+ * Instead of dumping the raw arrays every epoch, the telemetry_watcher
+ * summarizes them (fixed-bin histogram, min, max, mean, standard
+ * deviation and sparsity) on a background thread and appends the
+ * summaries to a single binary log per run. The format of the log is
+ * described in telemetry_record.hpp.
+ */
+
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dll/watcher.hpp"
+
+#include "parallel.hpp"
+#include "telemetry_record.hpp"
+
+namespace telemetry_detail {
+
+/*!
+ * \brief The log of the run, shared by all the watchers of the process.
+ *
+ * The file is $TELEMETRY_LOG (telemetry.bin by default) and is
+ * truncated the first time it is opened by the process.
+ */
+struct telemetry_log {
+    std::mutex mutex;
+    std::ofstream stream;
+    std::atomic<uint32_t> layers{0};
+
+    static telemetry_log& instance(){
+        static telemetry_log log;
+        return log;
+    }
+
+    void append(const telemetry_record& record){
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(!stream.is_open()){
+            auto path = std::getenv("TELEMETRY_LOG");
+            stream.open(path ? path : "telemetry.bin", std::ofstream::binary | std::ofstream::trunc);
+            stream.write(magic, sizeof(magic));
+        }
+
+        write_record(stream, record);
+        stream.flush();
+    }
+};
+
+template<typename Container>
+void copy_values(const Container& container, std::vector<float>& values){
+    values.clear();
+    for(auto v : container){
+        values.push_back(v);
+    }
+}
+
+//The hidden activations of the last batch, for the RBMs exposing them
+
+template<typename RBM>
+auto copy_hiddens(const RBM& rbm, std::vector<float>& values, int) -> decltype(void(rbm.h1_a)) {
+    copy_values(rbm.h1_a, values);
+}
+
+template<typename RBM>
+void copy_hiddens(const RBM& /*rbm*/, std::vector<float>& values, long){
+    values.clear();
+}
+
+} //end of namespace telemetry_detail
+
+template<std::size_t Bins = 100>
+struct telemetry_config {
+    static constexpr const std::size_t bins = Bins;
+};
+
+/*!
+ * \brief RBM watcher that logs the telemetry of the weights, the biases,
+ * the weight increments (difference with the previous epoch) and the
+ * hidden activations at the end of each epoch.
+ *
+ * The console output is the one of the default watcher. The arrays are
+ * copied at the end of the epoch and summarized by a background thread,
+ * so the training only waits if the summaries fall two epochs behind.
+ */
+template<typename RBM, typename C = telemetry_config<>>
+struct telemetry_watcher : dll::default_rbm_watcher<RBM> {
+    using base_type = dll::default_rbm_watcher<RBM>;
+
+    struct snapshot {
+        uint32_t epoch;
+        std::vector<float> weights;
+        std::vector<float> hidden_biases;
+        std::vector<float> visible_biases;
+        std::vector<float> hiddens;
+        std::vector<float> increments;
+    };
+
+    uint32_t layer = 0;
+    std::vector<float> previous_weights;
+    std::unique_ptr<bounded_queue<snapshot>> queue;
+    std::thread worker;
+
+    telemetry_watcher() = default;
+
+    telemetry_watcher(const telemetry_watcher&) = delete;
+    telemetry_watcher& operator=(const telemetry_watcher&) = delete;
+
+    //The summaries still queued are written if the training did not end normally
+    ~telemetry_watcher(){
+        stop();
+    }
+
+    void training_begin(const RBM& rbm){
+        base_type::training_begin(rbm);
+
+        layer = telemetry_detail::telemetry_log::instance().layers++;
+        telemetry_detail::copy_values(rbm.w, previous_weights);
+
+        queue = std::make_unique<bounded_queue<snapshot>>(2);
+        worker = std::thread([this]{
+            snapshot s;
+            while(queue->pop(s)){
+                log(s.epoch, "weights", s.weights);
+                log(s.epoch, "hidden_biases", s.hidden_biases);
+                log(s.epoch, "visible_biases", s.visible_biases);
+                log(s.epoch, "weights_inc", s.increments);
+
+                if(!s.hiddens.empty()){
+                    log(s.epoch, "hiddens", s.hiddens);
+                }
+            }
+        });
+    }
+
+    void epoch_end(std::size_t epoch, double error, double free_energy, const RBM& rbm){
+        base_type::epoch_end(epoch, error, free_energy, rbm);
+
+        snapshot s;
+        s.epoch = epoch;
+
+        telemetry_detail::copy_values(rbm.w, s.weights);
+        telemetry_detail::copy_values(rbm.b, s.hidden_biases);
+        telemetry_detail::copy_values(rbm.c, s.visible_biases);
+        telemetry_detail::copy_hiddens(rbm, s.hiddens, 0);
+
+        s.increments.resize(s.weights.size());
+        for(std::size_t i = 0; i < s.weights.size(); ++i){
+            s.increments[i] = s.weights[i] - previous_weights[i];
+        }
+
+        previous_weights = s.weights;
+
+        queue->push(std::move(s));
+    }
+
+    void training_end(const RBM& rbm){
+        stop();
+
+        base_type::training_end(rbm);
+    }
+
+private:
+    void stop(){
+        if(worker.joinable()){
+            queue->close();
+            worker.join();
+        }
+    }
+
+    void log(uint32_t epoch, const char* name, const std::vector<float>& values){
+        auto record = telemetry_detail::summarize(values, C::bins);
+        record.layer = layer;
+        record.epoch = epoch;
+        std::strncpy(record.name, name, sizeof(record.name) - 1);
+
+        telemetry_detail::telemetry_log::instance().append(record);
+    }
+};
+
+#endif
@@ -0,0 +1,155 @@
+//=======================================================================
+// Copyright (c) 2014-2015 Baptiste Wicht
+// Distributed under the terms of the MIT License.
+// (See accompanying file LICENSE or copy at
+//  http://opensource.org/licenses/MIT)
+//=======================================================================
+
+/*!
+ * \file telemetry_record.hpp
+ * \brief Format of the telemetry logs written by the telemetry_watcher.
+ *
+ * A log is a magic number followed by the records, each record being
+ * the summary of one array of one layer at one epoch. This header does
+ * not depend on DLL, so that the logs can be read by the report tools.
+ */
+
+#ifndef TELEMETRY_RECORD_HPP
+#define TELEMETRY_RECORD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Summary of one array at one epoch.
+ *
+ * The histogram has bins.size() bins of equal width covering [min, max].
+ */
+struct telemetry_record {
+    uint32_t layer = 0;
+    uint32_t epoch = 0;
+    char name[16] = {};
+    uint64_t count = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+    float mean = 0.0f;
+    float stddev = 0.0f;
+    float sparsity = 0.0f; ///< Fraction of values whose magnitude is below telemetry_sparsity_epsilon
+    std::vector<uint32_t> bins;
+};
+
+constexpr const float telemetry_sparsity_epsilon = 1e-3f;
+
+namespace telemetry_detail {
+
+constexpr const char magic[8] = {'T', 'E', 'L', 'E', 'M', 'E', 'T', '1'};
+
+/*!
+ * \brief Compute the summary of the values with the given number of bins
+ */
+inline telemetry_record summarize(const std::vector<float>& values, std::size_t bins){
+    telemetry_record record;
+    record.count = values.size();
+    record.bins.assign(bins, 0);
+
+    if(values.empty()){
+        return record;
+    }
+
+    auto mm = std::minmax_element(values.begin(), values.end());
+    record.min = *mm.first;
+    record.max = *mm.second;
+
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    std::size_t sparse = 0;
+
+    for(auto v : values){
+        sum += v;
+        sum_sq += static_cast<double>(v) * v;
+        sparse += std::abs(v) < telemetry_sparsity_epsilon;
+    }
+
+    auto mean = sum / values.size();
+
+    record.mean = mean;
+    record.stddev = std::sqrt(std::max(0.0, sum_sq / values.size() - mean * mean));
+    record.sparsity = static_cast<double>(sparse) / values.size();
+
+    double range = record.max - record.min;
+    double scale = range > 0.0 ? bins / range : 0.0;
+
+    for(auto v : values){
+        auto b = static_cast<std::size_t>((v - record.min) * scale);
+        ++record.bins[std::min(b, bins - 1)];
+    }
+
+    return record;
+}
+
+inline void write_record(std::ostream& os, const telemetry_record& record){
+    uint32_t header[3] = {record.layer, record.epoch, static_cast<uint32_t>(record.bins.size())};
+    float stats[5] = {record.min, record.max, record.mean, record.stddev, record.sparsity};
+
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    os.write(record.name, sizeof(record.name));
+    os.write(reinterpret_cast<const char*>(&record.count), sizeof(record.count));
+    os.write(reinterpret_cast<const char*>(stats), sizeof(stats));
+    os.write(reinterpret_cast<const char*>(record.bins.data()), record.bins.size() * sizeof(uint32_t));
+}
+
+inline bool read_record(std::istream& is, telemetry_record& record){
+    uint32_t header[3];
+    float stats[5];
+
+    if(!is.read(reinterpret_cast<char*>(header), sizeof(header))){
+        return false;
+    }
+
+    is.read(record.name, sizeof(record.name));
+    is.read(reinterpret_cast<char*>(&record.count), sizeof(record.count));
+    is.read(reinterpret_cast<char*>(stats), sizeof(stats));
+
+    record.layer = header[0];
+    record.epoch = header[1];
+    record.bins.resize(header[2]);
+    record.min = stats[0];
+    record.max = stats[1];
+    record.mean = stats[2];
+    record.stddev = stats[3];
+    record.sparsity = stats[4];
+
+    is.read(reinterpret_cast<char*>(record.bins.data()), record.bins.size() * sizeof(uint32_t));
+
+    return static_cast<bool>(is);
+}
+
+} //end of namespace telemetry_detail
+
+/*!
+ * \brief Read all the records of a telemetry log
+ */
+inline std::vector<telemetry_record> read_telemetry(const std::string& path){
+    std::vector<telemetry_record> records;
+
+    std::ifstream is(path, std::ifstream::binary);
+
+    char magic[sizeof(telemetry_detail::magic)];
+    if(!is.read(magic, sizeof(magic)) || std::memcmp(magic, telemetry_detail::magic, sizeof(magic)) != 0){
+        return records;
+    }
+
+    telemetry_record record;
+    while(telemetry_detail::read_record(is, record)){
+        records.push_back(record);
+    }
+
+    return records;
+}
+
+#endif